@@ -1,48 +1,76 @@
 #pragma once
 
 #include "SignalSimulation.hpp"
+#include "DistortionSpace.hpp"
+#include "ThreadPool.hpp"
+#include "PenetrationMap.hpp"
 
 #include <vector>
 #include <algorithm>
-#include <limits>
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include <memory>
+
+enum class BFSFrontier
+{
+	// Breadth-first sweeps; a connection is expanded again every time its power improves.
+	levels,
+	// Bots are taken in decreasing power order from a bucket queue over quantized dB,
+	// so a connection is only expanded again if it improves within the width of one bucket.
+	buckets
+};
 
 struct BFSSignalSimulationParameters {
 	Transmitter bestTransmitter;
 	Receiver bestReceiver;
 	Power minimumPower;
 	PowerCoefficient turnCoefficient;
+	BFSFrontier frontier;
+	double bucketWidth;
+	ThreadPoolPtr threadPool;
+	PenetrationMethod penetrationMethod;
 
 	BFSSignalSimulationParameters(
 		Transmitter bestTransmitter,
 		Receiver bestReceiver,
 		Power minimumPower,
-		PowerCoefficient turnCoefficient
+		PowerCoefficient turnCoefficient,
+		BFSFrontier frontier = BFSFrontier::levels,
+		double bucketWidth = 0.1,
+		ThreadPoolPtr threadPool = nullptr,
+		PenetrationMethod penetrationMethod = PenetrationMethod::exact
 	) :
 		bestTransmitter(bestTransmitter),
 		bestReceiver(bestReceiver),
 		minimumPower(minimumPower),
-		turnCoefficient(turnCoefficient)
+		turnCoefficient(turnCoefficient),
+		frontier(frontier),
+		bucketWidth(bucketWidth),
+		threadPool(threadPool),
+		penetrationMethod(penetrationMethod)
 	{ }
 };
 
-class BFSSignalSimulation : public SignalSimulation
+struct BFSSignalSimulationStatistics
+{
+	uint64_t simulations;
+	// Bots whose neighbours were relaxed.
+	uint64_t expansions;
+	// Connections whose power improved, each of which produced a new bot.
+	uint64_t improvements;
+};
+
+// Scalar is the storage type of the distortion space and of the connections map (double, float or QuantizedDecibels).
+template<typename Scalar>
+class BasicBFSSignalSimulation : public SignalSimulation
 {
 private:
-	struct Distortion
-	{
-		AbsorptionCoefficient absorption;
-		ObstacleDistortion reflection;
-	};
+	using CompactPowerCoefficient = Compact<LogPowerCoefficient, Scalar>;
 
 	struct Connection
 	{
-		Distance distance;
-		PowerCoefficient powerCoefficient;
-
-		Connection() :
-			distance(std::numeric_limits<double>::max()),
-			powerCoefficient(PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(0))
-		{ }
+		CompactPowerCoefficient powerCoefficient;
 	};
 
 	struct Bot
@@ -50,16 +78,19 @@ private:
 		DiscretePoint position;
 		int direction;
 		Distance distance;
+		CompactPowerCoefficient powerCoefficient;
 
-		Bot(DiscretePoint position, int direction, Distance distance) :
+		Bot(DiscretePoint position, int direction, Distance distance, CompactPowerCoefficient powerCoefficient) :
 			position(position),
 			direction(direction),
-			distance(distance)
+			distance(distance),
+			powerCoefficient(powerCoefficient)
 		{ }
 	};
 
 	const Frequency frequency;
 	const BFSSignalSimulationParameters simulationParameters;
+	const double turnDecibels;
 
 	const std::array<DiscreteDirection, 16> baseDirections{
 		{
@@ -113,70 +144,214 @@ private:
 				return i;
 	}
 
+	// Output of one chunk of the parallel passes. In the parallel expansion every worker owns a strip of columns:
+	// bots holds the bots of its strip, next the ones it queued for the following round and left and right
+	// the ones that it handed over to the neighbouring strips.
+	struct Worker
+	{
+		std::vector<Bot> bots;
+		std::vector<Bot> next;
+		std::vector<Bot> left;
+		std::vector<Bot> right;
+
+		uint64_t expansions = 0;
+		uint64_t improvements = 0;
+	};
+
+	struct Scratch
+	{
+		std::shared_ptr<SignalMap> signalMap;
+		SimulationUniformFiniteElementsSpace<std::array<Connection, 16>> connectionsMap;
+
+		std::vector<Bot> botsA;
+		std::vector<Bot> botsB;
+		std::vector<std::vector<Bot>> buckets;
+
+		std::vector<Worker> workers;
+
+		std::unique_ptr<PenetrationMap<>> penetrationMap;
+
+		Scratch(Surface surface, Distance precision, int workersCount = 1) :
+			signalMap(std::make_shared<SignalMap>(surface, precision)),
+			connectionsMap(surface, precision),
+			workers(workersCount)
+		{ }
+	};
+
+	static const int chunksPerThread = 4;
+	// Wider than the longest step of a bot, so that bots only ever move into the neighbouring strips.
+	static const int columnsPerStrip = 32;
+
+	struct Counters
+	{
+		std::atomic<uint64_t> simulations{ 0 };
+		std::atomic<uint64_t> expansions{ 0 };
+		std::atomic<uint64_t> improvements{ 0 };
+	};
+
 	SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition;
-	SimulationUniformFiniteElementsSpace<std::array<Distortion, 16>> simulationSpace;
+	DistortionSpace<16, Scalar, SparseUniformFiniteElementsSpace> simulationSpace;
+
+	std::unique_ptr<const AbsorptionMap<>> absorptionMap;
+
+	mutable Counters statistics;
 
 public:
-	BFSSignalSimulation(SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition, Frequency frequency, BFSSignalSimulationParameters simulationParameters) :
+	BasicBFSSignalSimulation(
+		SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition,
+		Frequency frequency,
+		BFSSignalSimulationParameters simulationParameters,
+		DistortionSpaceParameters distortionSpaceParameters = DistortionSpaceParameters()
+	) :
 		frequency(frequency),
 		simulationParameters(simulationParameters),
-		simulationSpace(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision),
+		turnDecibels(simulationParameters.turnCoefficient.get<PowerCoefficient::Unit::dB>()),
+		simulationSpace(simulationSpaceDefinition, baseDirections, { { frequency } }, distortionSpaceParameters),
 		simulationSpaceDefinition(simulationSpaceDefinition)
 	{
-		for (const auto& obstacle : simulationSpaceDefinition->obstacles)
-		{
-			for (int x = 0; x < simulationSpace.resolution.width; x++)
-			{
-				for (int y = 0; y < simulationSpace.resolution.height; y++)
-				{
-					DiscretePoint firstDiscretePosition(x, y);
-					Position firstPosition = simulationSpace.getPosition(firstDiscretePosition);
+		if (simulationParameters.penetrationMethod == PenetrationMethod::sweep)
+			absorptionMap.reset(new AbsorptionMap<>(*simulationSpaceDefinition, { { frequency } }));
+	}
+
+	virtual SignalMapPtr simulate(Position transmitterPosition) const
+	{
+		ThreadPool* threadPool = simulationParameters.threadPool.get();
+
+		int workersCount = 1;
+
+		if (threadPool && simulationParameters.frontier == BFSFrontier::levels)
+			workersCount = std::max(1, simulationSpace.resolution.width / columnsPerStrip);
+		else if (threadPool)
+			workersCount = (threadPool->size() + 1) * chunksPerThread;
+
+		Scratch scratch(simulationSpace.surface, simulationSpace.precision, workersCount);
+		simulate(transmitterPosition, scratch, threadPool);
+
+		return scratch.signalMap;
+	}
 
-					auto& element = simulationSpace.getElement(firstDiscretePosition);
+	// Always runs the bucket frontier, whatever the configured one, and stops as soon as no bot left could raise any of the receivers' cells,
+	// so nearby receivers are answered after a fraction of the propagation. With the level frontier configured the answers can
+	// differ from the simulated map by the rounding of the bucket width.
+	virtual std::vector<PowerCoefficient> query(Position transmitterPosition, const std::vector<Position>& receiverPositions) const
+	{
+		std::vector<DiscretePoint> targets;
 
-					for (int i = 0; i < baseDirections.size(); i++)
-					{
-						DiscretePoint secondDiscretePosition = firstDiscretePosition + baseDirections[i];
-						Position secondPosition = simulationSpace.getPosition(secondDiscretePosition);
+		for (const auto& receiverPosition : receiverPositions)
+			if (simulationSpace.inRange(receiverPosition))
+				targets.push_back(simulationSpace.getDiscretePoint(receiverPosition));
 
-						auto& connection = element[i];
+		if (targets.empty())
+			return std::vector<PowerCoefficient>(receiverPositions.size());
 
-						auto absorption = obstacle->absorption(firstPosition, secondPosition, frequency);
-						connection.absorption = connection.absorption + absorption;
+		Scratch scratch(simulationSpace.surface, simulationSpace.precision);
+		simulate(transmitterPosition, scratch, nullptr, targets);
 
-						auto distortion = obstacle->distortion(firstPosition, secondPosition, frequency);
-						connection.reflection = connection.reflection + distortion;
-					}
-				}
+		return sample(*scratch.signalMap, receiverPositions);
+	}
+
+	// Every transmitter is simulated by a single task, so the thread pool of the parameters is not used here.
+	virtual void simulateBatch(const std::vector<Position>& transmitterPositions, ThreadPoolPtr threadPool, SignalMapCallback callback) const
+	{
+		runBatch<Scratch>(
+			transmitterPositions,
+			threadPool,
+			[this] { return std::unique_ptr<Scratch>(new Scratch(simulationSpace.surface, simulationSpace.precision)); },
+			[this, &callback](int index, Position transmitterPosition, Scratch& scratch) {
+				scratch.signalMap->clear();
+				simulate(transmitterPosition, scratch, nullptr);
+
+				callback(index, *scratch.signalMap);
 			}
-		}
+		);
 	}
 
-	virtual SignalMapPtr simulate(Position transmitterPosition) const
+	// Totals over all simulations run since construction or the last reset.
+	BFSSignalSimulationStatistics getStatistics() const
+	{
+		BFSSignalSimulationStatistics result;
+		result.simulations = statistics.simulations;
+		result.expansions = statistics.expansions;
+		result.improvements = statistics.improvements;
+
+		return result;
+	}
+
+	void resetStatistics()
+	{
+		statistics.simulations = 0;
+		statistics.expansions = 0;
+		statistics.improvements = 0;
+	}
+
+private:
+	// The seeding pass resets every cell of the connections map, so a scratch can be reused without clearing it.
+	// With a thread pool the columns are seeded in chunks, which are also the strips of the parallel breadth-first rounds.
+	// The bucket frontier is inherently sequential and always runs on the calling thread; it also serves every query with targets and can stop early once all of them are settled.
+	void simulate(Position transmitterPosition, Scratch& scratch, ThreadPool* threadPool, std::vector<DiscretePoint> targets = std::vector<DiscretePoint>()) const
 	{
 		Point p = transmitterPosition.get<Distance::Unit::m>();
 		p.x += 0.0001;
 		p.y += 0.0002;
 		transmitterPosition = Position::in<Distance::Unit::m>(p);
 
-		DiscretePoint transmitterDiscretePoint = simulationSpace.getDiscretePoint(transmitterPosition);
+		auto& workers = scratch.workers;
+		int columns = simulationSpace.resolution.width;
 
-		auto signalMap = std::make_shared<SignalMap>(simulationSpace.surface, simulationSpace.precision);
-		auto minimumCoefficient =
-			simulationParameters.minimumPower /
-			(simulationParameters.bestTransmitter.power *
-				simulationParameters.bestTransmitter.antenaGain *
-				simulationParameters.bestReceiver.antenaGain);
+		if (absorptionMap)
+		{
+			if (!scratch.penetrationMap)
+				scratch.penetrationMap.reset(new PenetrationMap<>(simulationSpace.surface, simulationSpace.precision));
 
-		std::vector<Bot> botsA;
-		std::vector<Bot> botsB;
+			absorptionMap->sweep(transmitterPosition, *scratch.penetrationMap);
+		}
 
-		SimulationUniformFiniteElementsSpace<std::array<Connection, 16>> connectionsMap(
-			simulationSpace.surface,
-			simulationSpace.precision
-		);
+		if (!threadPool)
+		{
+			seed(transmitterPosition, 0, columns, scratch, scratch.botsA);
+		}
+		else
+		{
+			int chunks = (int)workers.size();
+
+			threadPool->parallelFor(chunks, [&](int chunk) {
+				seed(transmitterPosition, columns * chunk / chunks, columns * (chunk + 1) / chunks, scratch, workers[chunk].bots);
+			});
+
+			if (simulationParameters.frontier == BFSFrontier::buckets || !targets.empty())
+				gather(scratch);
+		}
+
+		if (simulationParameters.frontier == BFSFrontier::buckets || !targets.empty())
+			propagateByBuckets(scratch, transmitterPosition, targets);
+		else if (!threadPool)
+			propagateByLevels(scratch);
+		else
+			propagateByLevels(scratch, *threadPool);
 
-		for (int x = 0; x < simulationSpace.resolution.width; x++)
+		uint64_t expansions = 0;
+		uint64_t improvements = 0;
+
+		for (auto& worker : workers)
+		{
+			expansions += worker.expansions;
+			improvements += worker.improvements;
+
+			worker.expansions = 0;
+			worker.improvements = 0;
+		}
+
+		statistics.simulations++;
+		statistics.expansions += expansions;
+		statistics.improvements += improvements;
+	}
+
+	void seed(Position transmitterPosition, int firstColumn, int lastColumn, Scratch& scratch, std::vector<Bot>& bots) const
+	{
+		auto& signalMap = scratch.signalMap;
+		auto& connectionsMap = scratch.connectionsMap;
+
+		for (int x = firstColumn; x < lastColumn; x++)
 		{
 			for (int y = 0; y < simulationSpace.resolution.height; y++)
 			{
@@ -186,12 +361,14 @@ public:
 				Position inSightPositionposition = signalMap->getPosition(inSightDiscretePosition);
 				Distance distance = transmitterPosition.distanceTo(inSightPositionposition);
 
-				PowerCoefficient powerCoefficient = PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(1);
+				LogPowerCoefficient powerCoefficient = LogPowerCoefficient::in<LogPowerCoefficient::Unit::dB>(0);
 
-				for (const auto& obstacle : simulationSpaceDefinition->obstacles)
-				{
-					powerCoefficient = powerCoefficient * obstacle->absorption(transmitterPosition, inSightPositionposition, frequency).get<AbsorptionCoefficient::Unit::coefficient>(distance);
-				}
+				if (scratch.penetrationMap)
+					powerCoefficient = scratch.penetrationMap->getPowerCoefficient(inSightDiscretePosition);
+				else
+					simulationSpaceDefinition->forEachObstacle(transmitterPosition, inSightPositionposition, [&](const ObstaclePtr& obstacle) {
+						powerCoefficient = powerCoefficient * LogPowerCoefficient::of(obstacle->absorption(transmitterPosition, inSightPositionposition, frequency), distance);
+					});
 
 				DiscreteDirection direction = toBaseDirection(FreeVector(transmitterPosition.get<Distance::Unit::m>(), inSightPosition.get<Distance::Unit::m>()));
 				int directionIndex = toBaseDirectionIndex(direction);
@@ -199,71 +376,254 @@ public:
 				Bot bot(
 					inSightDiscretePosition,
 					directionIndex,
-					transmitterPosition.distanceTo(inSightPosition)
+					transmitterPosition.distanceTo(inSightPosition),
+					powerCoefficient
 				);
 
-				connectionsMap.getElement(inSightDiscretePosition)[directionIndex].powerCoefficient = powerCoefficient;
+				auto& connections = connectionsMap.getElement(inSightDiscretePosition);
+				for (auto& connection : connections)
+					connection.powerCoefficient = CompactPowerCoefficient();
+				connections[directionIndex].powerCoefficient = bot.powerCoefficient;
 
-				botsA.push_back(bot);
+				bots.push_back(bot);
 			}
 		}
+	}
+
+	// Moves the bots of all workers, in chunk order, into botsA.
+	static void gather(Scratch& scratch)
+	{
+		for (auto& worker : scratch.workers)
+		{
+			scratch.botsA.insert(scratch.botsA.end(), worker.bots.begin(), worker.bots.end());
+			worker.bots.clear();
+		}
+	}
+
+	void propagateByLevels(Scratch& scratch) const
+	{
+		auto& botsA = scratch.botsA;
+		auto& botsB = scratch.botsB;
+		auto& signalMap = *scratch.signalMap;
+		auto& worker = scratch.workers[0];
 
 		while (botsA.size())
 		{
 			for (auto& bot : botsA)
-			{
-				DiscretePoint& botPosition = bot.position;
-				Connection& botConnection = connectionsMap.getElement(botPosition)[bot.direction];
-
-				PowerCoefficient powerCoefficient = botConnection.powerCoefficient * std::pow(frequency / (bot.distance * 4 * 3.141592653589793238463), 2);
-				auto& signalMapElement = signalMap->getElement(botPosition);
-				if (signalMapElement < powerCoefficient)
-					signalMapElement = powerCoefficient;
-
-				for (int i = 0; i < baseDirections.size(); i++)
-				{
-					const DiscreteDirection& direction = baseDirections[i];
-					const DiscretePoint destinationPosition = botPosition + direction;
-
-					if (!simulationSpace.inRange(destinationPosition))
-						continue;
-
-					Connection& destinationConnection = connectionsMap.getElement(destinationPosition)[i];
-
-					double dotProduct = (FreeVector)direction * baseDirections[bot.direction];
-					dotProduct += 1;
-					dotProduct /= 2;
-					dotProduct = 1 - dotProduct;
-
-					PowerCoefficient turnCoefficient = PowerCoefficient::in<PowerCoefficient::Unit::dB>(
-						simulationParameters.turnCoefficient.get<PowerCoefficient::Unit::dB>() * dotProduct
-						);
-
-					auto& connection = simulationSpace.getElement(bot.position)[i];
-
-					Distance distance = simulationSpace.getPosition(botPosition).distanceTo(simulationSpace.getPosition(destinationPosition));
-					PowerCoefficient newPowerCoefficient =
-						botConnection.powerCoefficient *
-						turnCoefficient *
-						connection.absorption.get<AbsorptionCoefficient::Unit::coefficient>(distance);
-
-					if (destinationConnection.powerCoefficient < newPowerCoefficient)
-					{
-						destinationConnection.powerCoefficient = newPowerCoefficient;
-
-						botsB.push_back(Bot(
-							destinationPosition,
-							toBaseDirectionIndex(direction),
-							bot.distance + distance
-						));
-					}
-				}
-			}
+				expand(bot, scratch, signalMap, worker, [&](Connection& connection, const Bot& next) {
+					if (improve(connection, next, worker))
+						botsB.push_back(next);
+				});
 
 			botsA.clear();
 			std::swap(botsA, botsB);
 		}
+	}
+
+	// Every worker owns a strip of columns and is the only one to touch its connections and cells. A strip expands its bots
+	// just like the serial rounds do, but hands the bots that step into a neighbouring strip over to it, which takes them
+	// before expanding its own bots of the next round. The strips run as a wavefront: strip s expands round k in step 2k + s,
+	// after its left neighbour has expanded the same round and its right neighbour the previous one, so improvements coming
+	// from the left are seen within the round, as in the column order of the serial rounds. The strips that run in a step
+	// are two strips apart and every hand-over is taken in the step after it was made, so the steps run in parallel
+	// and the result depends neither on the scheduling nor on the size of the pool.
+	void propagateByLevels(Scratch& scratch, ThreadPool& threadPool) const
+	{
+		auto& workers = scratch.workers;
+		auto& signalMap = *scratch.signalMap;
+
+		int strips = (int)workers.size();
+		int columns = simulationSpace.resolution.width;
 
-		return signalMap;
+		for (int step = 0; ; step++)
+		{
+			int first = step % 2;
+			int last = std::min(step, strips - 1);
+			int count = last < first ? 0 : (last - first) / 2 + 1;
+
+			threadPool.parallelFor(count, [&](int task) {
+				int strip = first + task * 2;
+				Worker& worker = workers[strip];
+
+				int firstColumn = columns * strip / strips;
+				int lastColumn = columns * (strip + 1) / strips;
+
+				auto take = [&](const std::vector<Bot>& bots) {
+					for (const auto& bot : bots)
+						if (improve(scratch.connectionsMap.getElement(bot.position)[bot.direction], bot, worker))
+							worker.next.push_back(bot);
+				};
+
+				if (strip > 0)
+					take(workers[strip - 1].right);
+				if (strip + 1 < strips)
+					take(workers[strip + 1].left);
+
+				worker.left.clear();
+				worker.right.clear();
+
+				for (auto& bot : worker.bots)
+					expand(bot, scratch, signalMap, worker, [&](Connection& connection, const Bot& next) {
+						if (next.position.x < firstColumn)
+							worker.left.push_back(next);
+						else if (next.position.x >= lastColumn)
+							worker.right.push_back(next);
+						else if (improve(connection, next, worker))
+							worker.next.push_back(next);
+					});
+
+				worker.bots.clear();
+				std::swap(worker.bots, worker.next);
+			});
+
+			bool running = false;
+
+			for (int strip = 0; strip < strips && !running; strip++)
+				running =
+					!workers[strip].bots.empty() ||
+					(strip % 2 == first && strip <= step && (!workers[strip].left.empty() || !workers[strip].right.empty()));
+
+			if (!running)
+				break;
+		}
 	}
-};
\ No newline at end of file
+
+	// Dial's algorithm: powers only drop along a path, so taking the buckets from the strongest one
+	// settles every connection in order. Bots whose connection has improved since they were queued are stale and skipped.
+	void propagateByBuckets(Scratch& scratch, Position transmitterPosition, std::vector<DiscretePoint>& targets) const
+	{
+		auto& buckets = scratch.buckets;
+		auto& signalMap = *scratch.signalMap;
+		auto& worker = scratch.workers[0];
+
+		auto push = [this, &buckets](const Bot& bot, size_t minimumBucket) {
+			double decibels = LogPowerCoefficient(bot.powerCoefficient).get<LogPowerCoefficient::Unit::dB>();
+
+			if (!std::isfinite(decibels))
+				return;
+
+			size_t bucket = std::max(minimumBucket, (size_t)std::max(0., std::floor(-decibels / simulationParameters.bucketWidth)));
+
+			if (bucket >= buckets.size())
+				buckets.resize(bucket + 1);
+
+			buckets[bucket].push_back(bot);
+		};
+
+		for (const auto& bot : scratch.botsA)
+			push(bot, 0);
+
+		scratch.botsA.clear();
+
+		bool targeted = !targets.empty();
+
+		for (size_t bucket = 0; bucket < buckets.size(); bucket++)
+		{
+			if (targeted && settle(scratch, transmitterPosition, bucket, targets))
+			{
+				for (auto& remaining : buckets)
+					remaining.clear();
+
+				break;
+			}
+
+			while (!buckets[bucket].empty())
+			{
+				Bot bot = buckets[bucket].back();
+				buckets[bucket].pop_back();
+
+				if (bot.powerCoefficient < scratch.connectionsMap.getElement(bot.position)[bot.direction].powerCoefficient)
+					continue;
+
+				expand(bot, scratch, signalMap, worker, [&](Connection& connection, const Bot& next) {
+					if (improve(connection, next, worker))
+						push(next, bucket);
+				});
+			}
+		}
+	}
+
+	// Bots only lose power on their way and never travel less than the straight line from the transmitter, so a target is settled
+	// once even the strongest bot left could not raise it from there. Drops the settled targets and tells whether none is left.
+	bool settle(const Scratch& scratch, Position transmitterPosition, size_t bucket, std::vector<DiscretePoint>& targets) const
+	{
+		// Later buckets only hold bots below this bucket; the current one can also hold bots held back from earlier ones.
+		double strongest = -(double)(bucket + 1) * simulationParameters.bucketWidth;
+
+		for (const auto& bot : scratch.buckets[bucket])
+			strongest = std::max(strongest, LogPowerCoefficient(bot.powerCoefficient).get<LogPowerCoefficient::Unit::dB>());
+
+		PowerCoefficient bound = LogPowerCoefficient(strongest);
+
+		targets.erase(
+			std::remove_if(targets.begin(), targets.end(), [&](const DiscretePoint& target) {
+				Distance distance = transmitterPosition.distanceTo(simulationSpace.getPosition(target));
+				return !(scratch.signalMap->getElement(target) < bound * std::pow(frequency / (distance * 4 * 3.141592653589793238463), 2));
+			}),
+			targets.end()
+		);
+
+		return targets.empty();
+	}
+
+	// Raises the connection to the power of the bot and tells whether it improved.
+	static bool improve(Connection& connection, const Bot& bot, Worker& worker)
+	{
+		if (!(connection.powerCoefficient < bot.powerCoefficient))
+			return false;
+
+		connection.powerCoefficient = bot.powerCoefficient;
+		worker.improvements++;
+
+		return true;
+	}
+
+	// Raises the signal map at the bot and hands every neighbouring connection, together with the bot that would follow it, to relax.
+	template<typename Relax>
+	void expand(const Bot& bot, Scratch& scratch, SignalMap& signalMap, Worker& worker, Relax&& relax) const
+	{
+		const DiscretePoint& botPosition = bot.position;
+		const Connection& botConnection = scratch.connectionsMap.getElement(botPosition)[bot.direction];
+		const auto& botDistortions = simulationSpace.getElement(botPosition);
+		LogPowerCoefficient botPowerCoefficient = botConnection.powerCoefficient;
+
+		worker.expansions++;
+
+		PowerCoefficient powerCoefficient = PowerCoefficient(botPowerCoefficient) * std::pow(frequency / (bot.distance * 4 * 3.141592653589793238463), 2);
+		signalMap.raise(botPosition, powerCoefficient);
+
+		for (int i = 0; i < baseDirections.size(); i++)
+		{
+			const DiscreteDirection& direction = baseDirections[i];
+			const DiscretePoint destinationPosition = botPosition + direction;
+
+			if (!simulationSpace.inRange(destinationPosition))
+				continue;
+
+			Connection& destinationConnection = scratch.connectionsMap.getElement(destinationPosition)[i];
+
+			double dotProduct = (FreeVector)direction * baseDirections[bot.direction];
+			dotProduct += 1;
+			dotProduct /= 2;
+			dotProduct = 1 - dotProduct;
+
+			LogPowerCoefficient turnCoefficient = LogPowerCoefficient::in<LogPowerCoefficient::Unit::dB>(turnDecibels * dotProduct);
+
+			AbsorptionCoefficient absorption = botDistortions[i].absorption[0];
+
+			Distance distance = simulationSpace.getPosition(botPosition).distanceTo(simulationSpace.getPosition(destinationPosition));
+			CompactPowerCoefficient newPowerCoefficient =
+				botPowerCoefficient *
+				turnCoefficient *
+				LogPowerCoefficient::of(absorption, distance);
+
+			relax(destinationConnection, Bot(
+				destinationPosition,
+				i,
+				bot.distance + distance,
+				newPowerCoefficient
+			));
+		}
+	}
+};
+using BFSSignalSimulation = BasicBFSSignalSimulation<double>;
\ No newline at end of file
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "Math.hpp"
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+// Hierarchy over an ordered sequence of boxes. Every node covers a contiguous range of items,
+// so a traversal reports candidates in ascending index order, which the polygon edge walk relies on.
+class BoundingVolumeHierarchy
+{
+private:
+	struct Bounds
+	{
+		double minX, minY, maxX, maxY;
+
+		Bounds() :
+			minX(std::numeric_limits<double>::max()),
+			minY(std::numeric_limits<double>::max()),
+			maxX(std::numeric_limits<double>::lowest()),
+			maxY(std::numeric_limits<double>::lowest())
+		{ }
+
+		Bounds(const Rectangle& rectangle) :
+			minX(rectangle.minX()),
+			minY(rectangle.minY()),
+			maxX(rectangle.maxX()),
+			maxY(rectangle.maxY())
+		{ }
+
+		void extend(const Bounds& second)
+		{
+			minX = std::min(minX, second.minX);
+			minY = std::min(minY, second.minY);
+			maxX = std::max(maxX, second.maxX);
+			maxY = std::max(maxY, second.maxY);
+		}
+
+		bool intersects(const Vector& vector, double range) const
+		{
+			const double epsilon = 1e-6;
+
+			double tMin = 0;
+			double tMax = range;
+
+			if (!clip(vector.point.x, vector.freeVector.dx, minX - epsilon, maxX + epsilon, tMin, tMax))
+				return false;
+
+			return clip(vector.point.y, vector.freeVector.dy, minY - epsilon, maxY + epsilon, tMin, tMax);
+		}
+
+	private:
+		static bool clip(double origin, double direction, double min, double max, double& tMin, double& tMax)
+		{
+			if (direction == 0)
+				return origin >= min && origin <= max;
+
+			double t1 = (min - origin) / direction;
+			double t2 = (max - origin) / direction;
+
+			if (t1 > t2)
+				std::swap(t1, t2);
+
+			tMin = std::max(tMin, t1);
+			tMax = std::min(tMax, t2);
+
+			return tMin <= tMax;
+		}
+	};
+
+	struct Node
+	{
+		Bounds bounds;
+		int begin;
+		int end;
+		int left = -1;
+		int right = -1;
+	};
+
+	static const int leafSize = 4;
+	static const int maxDepth = 64;
+
+	std::vector<Node> nodes;
+	std::vector<Bounds> itemsBounds;
+
+	int build(int begin, int end)
+	{
+		int index = (int)nodes.size();
+		nodes.push_back(Node());
+		nodes[index].begin = begin;
+		nodes[index].end = end;
+
+		if (end - begin <= leafSize)
+		{
+			for (int i = begin; i < end; i++)
+				nodes[index].bounds.extend(itemsBounds[i]);
+		}
+		else
+		{
+			int middle = begin + (end - begin) / 2;
+
+			int left = build(begin, middle);
+			int right = build(middle, end);
+
+			nodes[index].left = left;
+			nodes[index].right = right;
+			nodes[index].bounds.extend(nodes[left].bounds);
+			nodes[index].bounds.extend(nodes[right].bounds);
+		}
+
+		return index;
+	}
+
+public:
+	BoundingVolumeHierarchy()
+	{ }
+
+	BoundingVolumeHierarchy(const std::vector<Rectangle>& items)
+	{
+		for (const auto& item : items)
+			itemsBounds.push_back(Bounds(item));
+
+		if (itemsBounds.size() > 0)
+			build(0, (int)itemsBounds.size());
+	}
+
+	// Reports indices of items whose boxes the vector may cross within [0, range] of its length.
+	// An infinite range turns the vector into a half-line.
+	template<typename Callback>
+	void traverse(const Vector& vector, double range, Callback&& callback) const
+	{
+		if (nodes.empty())
+			return;
+
+		int stack[maxDepth];
+		int stackSize = 0;
+
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+
+			if (!node.bounds.intersects(vector, range))
+				continue;
+
+			if (node.left < 0)
+			{
+				for (int i = node.begin; i < node.end; i++)
+					if (itemsBounds[i].intersects(vector, range))
+						callback(i);
+			}
+			else
+			{
+				stack[stackSize++] = node.right;
+				stack[stackSize++] = node.left;
+			}
+		}
+	}
+
+	template<typename Callback>
+	void traverse(const Vector& vector, Callback&& callback) const
+	{
+		traverse(vector, std::numeric_limits<double>::infinity(), std::forward<Callback>(callback));
+	}
+};
\ No newline at end of file
@@ -1,34 +1,35 @@
 #pragma once
 
 #include "SignalSimulation.hpp"
+#include "ThreadPool.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
 
 class BuildingMap : protected SimulationUniformFiniteElementsSpace<int>
 {
 public:
-	BuildingMap(SignalSimulationSpaceDefinitionPtr simulationSpace) :
+	BuildingMap(SignalSimulationSpaceDefinitionPtr simulationSpace, ThreadPoolPtr threadPool = nullptr, int bandHeight = 64) :
 		SimulationUniformFiniteElementsSpace(simulationSpace->spaceSize, simulationSpace->precision)
 	{
 		for (int x = 0; x < resolution.width; x++)
 			for (int y = 0; y < resolution.height; y++)
 				getElement(DiscretePoint(x, y)) = 0;
 
-		for (const auto& obstacle : simulationSpace->obstacles)
-		{
-			for (int x = 0; x < resolution.width; x++)
+		int bands = (resolution.height + bandHeight - 1) / bandHeight;
+
+		parallelFor(threadPool, bands, [this, &simulationSpace, bandHeight](int band) {
+			int firstRow = band * bandHeight;
+			int lastRow = std::min(resolution.height, firstRow + bandHeight);
+
+			for (const auto& obstacle : simulationSpace->obstacles)
 			{
-				for (int y = 0; y < resolution.height; y++)
-				{
-					DiscretePoint elementDiscretePosition(x, y);
-					Position elementPosition = getPosition(elementDiscretePosition);
-
-					if (obstacle->inside(elementPosition))
-					{
-						auto& element = getElement(elementDiscretePosition);
-						element++;
-					}
-				}
+				forEachElementInside(*obstacle, firstRow, lastRow, [this](const DiscretePoint& point) {
+					getElement(point)++;
+				});
 			}
-		}
+		});
 	}
 
 	bool hasObstacle(Position position) const
@@ -38,5 +39,43 @@ public:
 
 		return getElement(position) > 0;
 	}
+
+	// Obstacle mask over the same pixels as SignalMap::resample: 1 where the cell of the pixel is inside of an obstacle.
+	std::vector<uint8_t> resample(const Rectangle& area, int width, int height) const
+	{
+		return resample(area, width, height, 0, height);
+	}
+
+	// Rows [firstRow, lastRow) of the mask above, to go along with a block of SignalMap::resampleInBlocks.
+	std::vector<uint8_t> resample(const Rectangle& area, int width, int height, int firstRow, int lastRow) const
+	{
+		Point origin = getPosition(DiscretePoint(0, 0)).get<Distance::Unit::m>();
+		double unit = precision.get<Distance::Unit::m>();
+
+		std::vector<int> cells(width);
+
+		for (int column = 0; column < width; column++)
+			cells[column] = (int)std::floor((area.minX() + area.getWidth() * column / width - origin.x) / unit);
+
+		std::vector<uint8_t> mask((size_t)width * (lastRow - firstRow), 0);
+
+		for (int row = firstRow; row < lastRow; row++)
+		{
+			int y = (int)std::floor((area.minY() + area.getHeight() * row / height - origin.y) / unit);
+
+			if (y < 0 || y >= resolution.height)
+				continue;
+
+			for (int column = 0; column < width; column++)
+			{
+				int x = cells[column];
+
+				if (x >= 0 && x < resolution.width && getElement(DiscretePoint(x, y)) > 0)
+					mask[(size_t)(row - firstRow) * width + column] = 1;
+			}
+		}
+
+		return mask;
+	}
 };
 using BuildingMapPtr = std::shared_ptr<const BuildingMap>;
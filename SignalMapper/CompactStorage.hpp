@@ -0,0 +1,252 @@
+#pragma once
+
+#include "Physics.hpp"
+#include "Obstacle.hpp"
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+// Storage scalar that keeps quantities as 16-bit fixed point numbers: power in 0.01 dB steps,
+// absorption in 0.02 dB/m steps and directions in 1/32767 steps.
+struct QuantizedDecibels
+{ };
+
+// Compact<Quantity, Scalar> stores a quantity of a per-cell grid with the given storage scalar
+// (double, float or QuantizedDecibels) and converts to and from the full precision type.
+template<typename Quantity, typename Scalar>
+struct Compact;
+
+template<typename Scalar>
+struct Compact<PowerCoefficient, Scalar>
+{
+	Scalar coefficient;
+
+	Compact() :
+		coefficient(0)
+	{ }
+
+	Compact(const PowerCoefficient& value) :
+		coefficient((Scalar)value.get<PowerCoefficient::Unit::coefficient>())
+	{ }
+
+	operator PowerCoefficient() const
+	{
+		return PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(coefficient);
+	}
+
+	bool affects() const { return coefficient != 0; }
+
+	friend bool operator<(const Compact& a, const Compact& b)
+	{
+		return a.coefficient < b.coefficient;
+	}
+};
+
+template<>
+struct Compact<PowerCoefficient, QuantizedDecibels>
+{
+	static const int16_t zero = INT16_MIN;
+
+	int16_t centibels;
+
+	Compact() :
+		centibels(zero)
+	{ }
+
+	Compact(const PowerCoefficient& value)
+	{
+		double coefficient = value.get<PowerCoefficient::Unit::coefficient>();
+
+		if (coefficient <= 0)
+			centibels = zero;
+		else
+			centibels = (int16_t)std::max<double>(zero + 1, std::min<double>(INT16_MAX, std::round(value.get<PowerCoefficient::Unit::dB>() * 100)));
+	}
+
+	operator PowerCoefficient() const
+	{
+		if (centibels == zero)
+			return PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(0);
+
+		return PowerCoefficient::in<PowerCoefficient::Unit::dB>(centibels / 100.);
+	}
+
+	bool affects() const { return centibels != zero; }
+
+	friend bool operator<(const Compact& a, const Compact& b)
+	{
+		return a.centibels < b.centibels;
+	}
+};
+
+template<typename Scalar>
+struct Compact<LogPowerCoefficient, Scalar>
+{
+	Scalar dB;
+
+	Compact() :
+		dB(-std::numeric_limits<Scalar>::infinity())
+	{ }
+
+	Compact(const LogPowerCoefficient& value) :
+		dB((Scalar)value.get<LogPowerCoefficient::Unit::dB>())
+	{ }
+
+	operator LogPowerCoefficient() const
+	{
+		return LogPowerCoefficient(dB);
+	}
+
+	friend bool operator<(const Compact& a, const Compact& b)
+	{
+		return a.dB < b.dB;
+	}
+};
+
+template<>
+struct Compact<LogPowerCoefficient, QuantizedDecibels>
+{
+	static const int16_t zero = INT16_MIN;
+
+	int16_t centibels;
+
+	Compact() :
+		centibels(zero)
+	{ }
+
+	Compact(const LogPowerCoefficient& value) :
+		centibels((int16_t)std::max<double>(zero, std::min<double>(INT16_MAX, std::round(value.get<LogPowerCoefficient::Unit::dB>() * 100))))
+	{ }
+
+	operator LogPowerCoefficient() const
+	{
+		if (centibels == zero)
+			return LogPowerCoefficient();
+
+		return LogPowerCoefficient(centibels / 100.);
+	}
+
+	friend bool operator<(const Compact& a, const Compact& b)
+	{
+		return a.centibels < b.centibels;
+	}
+};
+
+template<typename Scalar>
+struct Compact<AbsorptionCoefficient, Scalar>
+{
+	Scalar alpha;
+
+	Compact() :
+		alpha(0)
+	{ }
+
+	Compact(const AbsorptionCoefficient& value) :
+		alpha((Scalar)value.get<AbsorptionCoefficient::Unit::alpha>(Distance::in<Distance::Unit::m>(1)))
+	{ }
+
+	operator AbsorptionCoefficient() const
+	{
+		return AbsorptionCoefficient(alpha);
+	}
+
+	bool affects() const { return alpha != 0; }
+};
+
+template<>
+struct Compact<AbsorptionCoefficient, QuantizedDecibels>
+{
+	static constexpr double step = 0.02;
+
+	int16_t decibelsPerMeter;
+
+	Compact() :
+		decibelsPerMeter(0)
+	{ }
+
+	Compact(const AbsorptionCoefficient& value)
+	{
+		double decibels = value.get<AbsorptionCoefficient::Unit::alpha>(Distance::in<Distance::Unit::m>(1)) * 10 / std::log(10.);
+		decibelsPerMeter = (int16_t)std::max<double>(INT16_MIN, std::min<double>(INT16_MAX, std::round(decibels / step)));
+	}
+
+	operator AbsorptionCoefficient() const
+	{
+		return AbsorptionCoefficient(decibelsPerMeter * step * std::log(10.) / 10);
+	}
+
+	bool affects() const { return decibelsPerMeter != 0; }
+};
+
+template<typename Scalar>
+struct Compact<FreeVector, Scalar>
+{
+	Scalar dx;
+	Scalar dy;
+
+	Compact() :
+		dx(0), dy(0)
+	{ }
+
+	Compact(const FreeVector& value) :
+		dx((Scalar)value.dx), dy((Scalar)value.dy)
+	{ }
+
+	operator FreeVector() const
+	{
+		return FreeVector(dx, dy);
+	}
+};
+
+// Only meant for unit vectors.
+template<>
+struct Compact<FreeVector, QuantizedDecibels>
+{
+	static const int16_t one = INT16_MAX;
+
+	int16_t dx;
+	int16_t dy;
+
+	Compact() :
+		dx(0), dy(0)
+	{ }
+
+	Compact(const FreeVector& value) :
+		dx(quantize(value.dx)), dy(quantize(value.dy))
+	{ }
+
+	operator FreeVector() const
+	{
+		return FreeVector((double)dx / one, (double)dy / one);
+	}
+
+private:
+	static int16_t quantize(double value)
+	{
+		return (int16_t)std::round(std::max(-1., std::min(1., value)) * one);
+	}
+};
+
+template<typename Scalar>
+struct Compact<ObstacleDistortion, Scalar>
+{
+	Compact<FreeVector, Scalar> normalVector;
+	Compact<PowerCoefficient, Scalar> coefficient;
+
+	Compact()
+	{ }
+
+	Compact(const ObstacleDistortion& value) :
+		normalVector(value.normalVector),
+		coefficient(value.coefficient)
+	{ }
+
+	operator ObstacleDistortion() const
+	{
+		return ObstacleDistortion(normalVector, coefficient);
+	}
+
+	bool affects() const { return coefficient.affects(); }
+};
\ No newline at end of file
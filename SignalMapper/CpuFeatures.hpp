@@ -0,0 +1,43 @@
+#pragma once
+
+// AVX2 code paths are compiled on x86 whenever the compiler allows per-function instruction sets (MSVC always does,
+// GCC and Clang through the target attribute) and are only taken if supportsAvx2() confirms the processor has it.
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define SIGNAL_MAPPER_AVX2
+#define SIGNAL_MAPPER_TARGET_AVX2
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SIGNAL_MAPPER_AVX2
+#define SIGNAL_MAPPER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#if defined(SIGNAL_MAPPER_AVX2)
+inline bool supportsAvx2()
+{
+	static const bool supported = [] {
+#if defined(_MSC_VER)
+		int registers[4];
+
+		__cpuid(registers, 0);
+		if (registers[0] < 7)
+			return false;
+
+		__cpuid(registers, 1);
+		bool osxsave = (registers[2] & (1 << 27)) != 0;
+		bool avx = (registers[2] & (1 << 28)) != 0;
+
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(registers, 7, 0);
+		return (registers[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}();
+
+	return supported;
+}
+#endif
\ No newline at end of file
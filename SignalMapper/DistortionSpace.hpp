@@ -0,0 +1,463 @@
+#pragma once
+
+#include "SignalSimulation.hpp"
+#include "ThreadPool.hpp"
+#include "MappedFile.hpp"
+#include "Fingerprint.hpp"
+#include "SparseUniformFiniteElementsSpace.hpp"
+#include "CompactStorage.hpp"
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// Distortions of one connection in every simulated band. The values of all bands are kept side by side.
+template<typename Scalar = double, size_t Bands = 1>
+struct ConnectionDistortion
+{
+	std::array<Compact<AbsorptionCoefficient, Scalar>, Bands> absorption;
+	std::array<Compact<ObstacleDistortion, Scalar>, Bands> reflection;
+
+	bool affects() const
+	{
+		for (size_t band = 0; band < Bands; band++)
+			if (absorption[band].affects() || reflection[band].affects())
+				return true;
+
+		return false;
+	}
+};
+
+enum class DistortionSpaceConstruction
+{
+	exhaustive,
+	boundaryDriven
+};
+
+struct DistortionSpaceParameters
+{
+	DistortionSpaceConstruction construction;
+	ThreadPoolPtr threadPool;
+	int tileSize;
+	std::string cacheFile;
+
+	DistortionSpaceParameters(
+		DistortionSpaceConstruction construction = DistortionSpaceConstruction::boundaryDriven,
+		ThreadPoolPtr threadPool = nullptr,
+		int tileSize = 64,
+		std::string cacheFile = ""
+	) :
+		construction(construction),
+		threadPool(threadPool),
+		tileSize(tileSize),
+		cacheFile(cacheFile)
+	{ }
+};
+
+// Scalar is the storage type of the distortions (double, float or QuantizedDecibels).
+// Storage is either UniformFiniteElementsSpace (every cell owns its distortions)
+// or SparseUniformFiniteElementsSpace (only cells touched by obstacles do).
+// Bands is the number of frequencies for which the distortions are evaluated in one pass over the geometry.
+template<size_t Directions, typename Scalar = double, template<typename> class Storage = UniformFiniteElementsSpace, size_t Bands = 1>
+class DistortionSpace : public SimulationUniformFiniteElementsSpace<std::array<ConnectionDistortion<Scalar, Bands>, Directions>, Storage<std::array<ConnectionDistortion<Scalar, Bands>, Directions>>>
+{
+private:
+	using Element = std::array<ConnectionDistortion<Scalar, Bands>, Directions>;
+	using ElementsStorage = Storage<Element>;
+
+	static_assert(std::is_trivially_copyable<Element>::value, "Distortion space elements are stored as raw bytes");
+
+	struct CacheHeader
+	{
+		char magic[8];
+		uint64_t key;
+		uint32_t version;
+		uint32_t elementSize;
+		int32_t width;
+		int32_t height;
+		uint32_t sparse;
+		char reserved[28];
+	};
+
+	static_assert(sizeof(CacheHeader) == 64, "Elements of a cache file have to stay aligned");
+
+	static const uint32_t cacheVersion = 3;
+
+	static const char* cacheMagic() { return "SIGDIST"; }
+
+	enum Candidate : char
+	{
+		none,
+		interior,
+		boundary
+	};
+
+	struct Evaluation
+	{
+		int obstacle;
+		DiscretePoint point;
+		bool reflections;
+	};
+
+	const std::array<DiscreteDirection, Directions> directions;
+	const std::array<Frequency, Bands> frequencies;
+	const DistortionSpaceParameters parameters;
+
+	int tilesInRow() const
+	{
+		return (this->resolution.width + parameters.tileSize - 1) / parameters.tileSize;
+	}
+
+	int tilesCount() const
+	{
+		return tilesInRow() * ((this->resolution.height + parameters.tileSize - 1) / parameters.tileSize);
+	}
+
+	int tileOf(const DiscretePoint& point) const
+	{
+		return point.y / parameters.tileSize * tilesInRow() + point.x / parameters.tileSize;
+	}
+
+	void evaluate(const Obstacle& obstacle, const DiscretePoint& firstDiscretePosition, bool reflections)
+	{
+		Position firstPosition = this->getPosition(firstDiscretePosition);
+
+		auto& element = this->getElement(firstDiscretePosition);
+
+		for (int i = 0; i < directions.size(); i++)
+		{
+			DiscretePoint secondDiscretePosition = firstDiscretePosition + directions[i];
+			Position secondPosition = this->getPosition(secondDiscretePosition);
+
+			auto& connection = element[i];
+
+			for (size_t band = 0; band < Bands; band++)
+			{
+				auto absorption = obstacle.absorption(firstPosition, secondPosition, frequencies[band]);
+				connection.absorption[band] = AbsorptionCoefficient(connection.absorption[band]) + absorption;
+
+				if (!reflections)
+					continue;
+
+				auto distortion = obstacle.distortion(firstPosition, secondPosition, frequencies[band]);
+				connection.reflection[band] = ObstacleDistortion(connection.reflection[band]) + distortion;
+			}
+		}
+	}
+
+	static bool affects(const Element& element)
+	{
+		for (const auto& connection : element)
+			if (connection.affects())
+				return true;
+
+		return false;
+	}
+
+	void buildExhaustively(const SignalSimulationSpaceDefinition& simulationSpaceDefinition)
+	{
+		std::vector<std::vector<std::pair<int, Element>>> found(tilesCount());
+
+		parallelFor(parameters.threadPool, tilesCount(), [this, &simulationSpaceDefinition, &found](int tile) {
+			int tileX = tile % tilesInRow() * parameters.tileSize;
+			int tileY = tile / tilesInRow() * parameters.tileSize;
+
+			buildExhaustively(
+				simulationSpaceDefinition,
+				DiscretePoint(tileX, tileY),
+				DiscretePoint(std::min(this->resolution.width, tileX + parameters.tileSize), std::min(this->resolution.height, tileY + parameters.tileSize)),
+				found[tile]
+			);
+		});
+
+		if (!ElementsStorage::sparse)
+			return;
+
+		std::vector<std::pair<int, Element>> elements;
+		for (const auto& tile : found)
+			elements.insert(elements.end(), tile.begin(), tile.end());
+
+		std::sort(elements.begin(), elements.end(), [](const std::pair<int, Element>& a, const std::pair<int, Element>& b) {
+			return a.first < b.first;
+		});
+
+		std::vector<int> indices;
+		for (const auto& element : elements)
+			indices.push_back(element.first);
+
+		this->occupy(indices);
+
+		for (const auto& element : elements)
+			this->getElement(DiscretePoint(element.first % this->resolution.width, element.first / this->resolution.width)) = element.second;
+	}
+
+	// A sparse space is only occupied once all cells are known, so its elements are first collected per tile.
+	void buildExhaustively(const SignalSimulationSpaceDefinition& simulationSpaceDefinition, DiscretePoint begin, DiscretePoint end, std::vector<std::pair<int, Element>>& found)
+	{
+		for (int x = begin.x; x < end.x; x++)
+		{
+			for (int y = begin.y; y < end.y; y++)
+			{
+				DiscretePoint firstDiscretePosition(x, y);
+				Position firstPosition = this->getPosition(firstDiscretePosition);
+
+				Element sparseElement = Element();
+				auto& element = ElementsStorage::sparse ? sparseElement : this->getElement(firstDiscretePosition);
+
+				for (int i = 0; i < directions.size(); i++)
+				{
+					DiscretePoint secondDiscretePosition = firstDiscretePosition + directions[i];
+					Position secondPosition = this->getPosition(secondDiscretePosition);
+
+					auto& connection = element[i];
+
+					simulationSpaceDefinition.forEachObstacle(firstPosition, secondPosition, [&](const ObstaclePtr& obstacle) {
+						for (size_t band = 0; band < Bands; band++)
+						{
+							auto absorption = obstacle->absorption(firstPosition, secondPosition, frequencies[band]);
+							connection.absorption[band] = AbsorptionCoefficient(connection.absorption[band]) + absorption;
+
+							auto distortion = obstacle->distortion(firstPosition, secondPosition, frequencies[band]);
+							connection.reflection[band] = ObstacleDistortion(connection.reflection[band]) + distortion;
+						}
+					});
+				}
+
+				if (ElementsStorage::sparse && affects(element))
+					found.push_back(std::make_pair(y * this->resolution.width + x, element));
+			}
+		}
+	}
+
+	// A connection can only be affected by an obstacle if it starts inside of it or crosses one of its edges,
+	// so only the rasterized interior and a band of cells along every edge are evaluated.
+	// Evaluations are grouped by tile in obstacle order, which keeps every cell's accumulation order serial.
+	void buildFromBoundaries(const SignalSimulationSpaceDefinition& simulationSpaceDefinition)
+	{
+		int reach = 2;
+		for (const auto& direction : directions)
+			reach = std::max(reach, std::max(std::abs(direction.x), std::abs(direction.y)) + 2);
+
+		std::vector<Candidate> candidates(this->resolution.width * this->resolution.height, Candidate::none);
+		std::vector<DiscretePoint> touched;
+
+		auto mark = [&](const DiscretePoint& point, Candidate candidate) {
+			if (!this->inRange(point))
+				return;
+
+			auto& current = candidates[point.y * this->resolution.width + point.x];
+
+			if (current == Candidate::none)
+				touched.push_back(point);
+
+			current = std::max(current, candidate);
+		};
+
+		std::vector<std::vector<Evaluation>> tiles(tilesCount());
+
+		for (int o = 0; o < simulationSpaceDefinition.obstacles.size(); o++)
+		{
+			const auto& obstacle = simulationSpaceDefinition.obstacles[o];
+
+			this->forEachElementInside(*obstacle, [&](const DiscretePoint& point) {
+				mark(point, Candidate::interior);
+			});
+
+			obstacle->boundary([&](Position begin, Position end) {
+				Point origin = this->getPosition(DiscretePoint(0, 0)).template get<Distance::Unit::m>();
+				Point a = begin.get<Distance::Unit::m>();
+				Point b = end.get<Distance::Unit::m>();
+
+				double unit = this->precision.template get<Distance::Unit::m>();
+				int steps = (int)std::ceil(begin.distanceTo(end) / this->precision * 2) + 1;
+
+				for (int step = 0; step <= steps; step++)
+				{
+					double t = (double)step / steps;
+
+					DiscretePoint center(
+						(int)std::floor((a.x + (b.x - a.x) * t - origin.x) / unit),
+						(int)std::floor((a.y + (b.y - a.y) * t - origin.y) / unit)
+					);
+
+					for (int dx = -reach; dx <= reach; dx++)
+						for (int dy = -reach; dy <= reach; dy++)
+							mark(DiscretePoint(center.x + dx, center.y + dy), Candidate::boundary);
+				}
+			});
+
+			for (const auto& point : touched)
+			{
+				tiles[tileOf(point)].push_back({ o, point, candidates[point.y * this->resolution.width + point.x] == Candidate::boundary });
+				candidates[point.y * this->resolution.width + point.x] = Candidate::none;
+			}
+
+			touched.clear();
+		}
+
+		if (ElementsStorage::sparse)
+		{
+			std::vector<int> indices;
+
+			for (const auto& tile : tiles)
+				for (const auto& evaluation : tile)
+					indices.push_back(evaluation.point.y * this->resolution.width + evaluation.point.x);
+
+			std::sort(indices.begin(), indices.end());
+			indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+			this->occupy(indices);
+		}
+
+		parallelFor(parameters.threadPool, (int)tiles.size(), [this, &tiles, &simulationSpaceDefinition](int tile) {
+			for (const auto& evaluation : tiles[tile])
+				evaluate(*simulationSpaceDefinition.obstacles[evaluation.obstacle], evaluation.point, evaluation.reflections);
+		});
+	}
+
+	static uint64_t cacheKey(
+		const SignalSimulationSpaceDefinition& simulationSpaceDefinition,
+		const std::array<DiscreteDirection, Directions>& directions,
+		const std::array<Frequency, Bands>& frequencies)
+	{
+		Fingerprint fingerprint;
+
+		fingerprint << (int)cacheVersion << (int)sizeof(Element) << (int)Directions << (int)ElementsStorage::sparse;
+
+		for (const auto& direction : directions)
+			fingerprint << direction.x << direction.y;
+
+		fingerprint << (int)Bands;
+
+		for (const auto& frequency : frequencies)
+			simulationSpaceDefinition.fingerprint(fingerprint, frequency);
+
+		return fingerprint.get();
+	}
+
+	// Maps a cache file written by saveCache, provided that it was built for exactly the same space.
+	// The elements are used in place; a missing, stale or damaged file yields nullptr.
+	static typename ElementsStorage::Elements loadCache(
+		const SignalSimulationSpaceDefinition& simulationSpaceDefinition,
+		const std::array<DiscreteDirection, Directions>& directions,
+		const std::array<Frequency, Bands>& frequencies,
+		const DistortionSpaceParameters& parameters)
+	{
+		if (parameters.cacheFile.empty())
+			return nullptr;
+
+		auto file = MappedFile::open(parameters.cacheFile);
+		if (!file || file->getSize() < sizeof(CacheHeader))
+			return nullptr;
+
+		const CacheHeader& header = *(const CacheHeader*)file->getData();
+
+		DiscreteSize resolution(
+			simulationSpaceDefinition.spaceSize.get<Distance::Unit::m>().getWidth(),
+			simulationSpaceDefinition.spaceSize.get<Distance::Unit::m>().getHeight(),
+			simulationSpaceDefinition.precision.get<Distance::Unit::m>()
+		);
+
+		if (std::memcmp(header.magic, cacheMagic(), sizeof(header.magic)) != 0 ||
+			header.version != cacheVersion ||
+			header.elementSize != sizeof(Element) ||
+			header.width != resolution.width ||
+			header.height != resolution.height ||
+			header.sparse != (uint32_t)ElementsStorage::sparse ||
+			header.key != cacheKey(simulationSpaceDefinition, directions, frequencies))
+			return nullptr;
+
+		return ElementsStorage::adopt(
+			file,
+			(char*)file->getData() + sizeof(CacheHeader),
+			file->getSize() - sizeof(CacheHeader),
+			resolution
+		);
+	}
+
+	void saveCache(const SignalSimulationSpaceDefinition& simulationSpaceDefinition) const
+	{
+		CacheHeader header = {};
+		std::memcpy(header.magic, cacheMagic(), sizeof(header.magic));
+		header.key = cacheKey(simulationSpaceDefinition, directions, frequencies);
+		header.version = cacheVersion;
+		header.elementSize = sizeof(Element);
+		header.width = this->resolution.width;
+		header.height = this->resolution.height;
+		header.sparse = ElementsStorage::sparse;
+
+		std::string temporaryFile = parameters.cacheFile + ".tmp";
+
+		std::ofstream file(temporaryFile, std::ios::out | std::ios::binary | std::ios::trunc);
+		file.write((const char*)&header, sizeof(header));
+		file.write((const char*)this->data(), this->dataSize());
+		file.close();
+
+		if (file.fail())
+		{
+			std::remove(temporaryFile.c_str());
+			return;
+		}
+
+		std::remove(parameters.cacheFile.c_str());
+		std::rename(temporaryFile.c_str(), parameters.cacheFile.c_str());
+	}
+
+	DistortionSpace(
+		SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition,
+		const std::array<DiscreteDirection, Directions>& directions,
+		const std::array<Frequency, Bands>& frequencies,
+		DistortionSpaceParameters parameters,
+		typename ElementsStorage::Elements cachedElements
+	) :
+		SimulationUniformFiniteElementsSpace<Element, ElementsStorage>(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision, cachedElements),
+		directions(directions),
+		frequencies(frequencies),
+		parameters(parameters)
+	{
+		if (cachedElements)
+			return;
+
+		switch (parameters.construction)
+		{
+		case DistortionSpaceConstruction::exhaustive:
+			buildExhaustively(*simulationSpaceDefinition);
+			break;
+		case DistortionSpaceConstruction::boundaryDriven:
+			buildFromBoundaries(*simulationSpaceDefinition);
+			break;
+		}
+
+		if (!parameters.cacheFile.empty())
+			saveCache(*simulationSpaceDefinition);
+	}
+
+public:
+	DistortionSpace(
+		SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition,
+		const std::array<DiscreteDirection, Directions>& directions,
+		const std::array<Frequency, Bands>& frequencies,
+		DistortionSpaceParameters parameters = DistortionSpaceParameters()
+	) :
+		DistortionSpace(
+			simulationSpaceDefinition,
+			directions,
+			frequencies,
+			parameters,
+			loadCache(*simulationSpaceDefinition, directions, frequencies, parameters)
+		)
+	{ }
+
+	// Whether any connection that starts in the cell is absorbed or reflected.
+	bool distorted(const DiscretePoint& point) const
+	{
+		return affects(this->getElement(point));
+	}
+};
\ No newline at end of file
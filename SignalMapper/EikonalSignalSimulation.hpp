@@ -0,0 +1,366 @@
+#pragma once
+
+#include "SignalSimulation.hpp"
+#include "PenetrationMap.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+struct EikonalSignalSimulationParameters {
+	Transmitter bestTransmitter;
+	Receiver bestReceiver;
+	Power minimumPower;
+	AbsorptionCoefficient detourAbsorption;
+
+	EikonalSignalSimulationParameters(
+		Transmitter bestTransmitter,
+		Receiver bestReceiver,
+		Power minimumPower,
+		AbsorptionCoefficient detourAbsorption
+	) :
+		bestTransmitter(bestTransmitter),
+		bestReceiver(bestReceiver),
+		minimumPower(minimumPower),
+		detourAbsorption(detourAbsorption)
+	{ }
+};
+
+// Fast marching over the simulation grid. The cost of reaching a cell solves the eikonal equation |grad T| = alpha + detour,
+// where alpha is the absorption of the cell rasterized by AbsorptionMap and detour is the detourAbsorption of the parameters,
+// so the signal goes around a wall wherever that costs less than going through it. The length of the path is carried along
+// with the cost, and every cell gets the free-space loss over that length times the absorption met on the way; the detour
+// is also charged for every metre the path is longer than the straight line, which stands in for the loss of bending around corners.
+// Every cell is settled once, in cost order, so a map takes O(N log N) whatever the geometry. Without any detour the cost
+// is flat in free space, and the length of the path orders the cells there.
+class EikonalSignalSimulation : public SignalSimulation
+{
+private:
+	enum State : uint8_t
+	{
+		unvisited,
+		trial,
+		settled
+	};
+
+	// Trial cells are taken by cost and, where the costs tie, by length, so that every cell gets the shortest of the cheapest paths.
+	struct Trial
+	{
+		double cost;
+		double length;
+		int index;
+
+		bool operator>(const Trial& other) const
+		{
+			return cost != other.cost ? cost > other.cost : length > other.length;
+		}
+	};
+
+	struct Scratch
+	{
+		std::shared_ptr<SignalMap> signalMap;
+
+		// Cost in nepers and length of the path in cells.
+		std::vector<double> costs;
+		std::vector<double> lengths;
+		std::vector<uint8_t> states;
+
+		std::vector<Trial> heap;
+
+		Scratch(Surface surface, Distance precision) :
+			signalMap(std::make_shared<SignalMap>(surface, precision))
+		{
+			size_t cells = (size_t)signalMap->resolution.width * signalMap->resolution.height;
+
+			costs.resize(cells);
+			lengths.resize(cells);
+			states.resize(cells);
+		}
+	};
+
+	// Cells around the transmitter within this many cells take their straight distance, so the front starts out round.
+	static const int sourceRadius = 2;
+
+	const Frequency frequency;
+	const EikonalSignalSimulationParameters simulationParameters;
+	const SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition;
+
+	DiscreteSize resolution;
+	double detour;
+	// Absorption of every cell in nepers per cell.
+	std::vector<double> absorptions;
+
+	// Solves the upwind update of the cell from its settled neighbours, on the axis-aligned and on the diagonal stencil,
+	// and keeps the lower cost. The length is transported along the same characteristic: grad L . grad T = |grad T|.
+	void update(int x, int y, Scratch& scratch) const
+	{
+		int index = y * resolution.width + x;
+		double weight = absorptions[index] + detour;
+
+		static const int stencils[2][2][2] = {
+			{ { 1, 0 }, { 0, 1 } },
+			{ { 1, 1 }, { 1, -1 } }
+		};
+		static const double spacings[2] = { 1, 1.4142135623730950488 };
+
+		double bestCost = scratch.costs[index];
+		double bestLength = scratch.lengths[index];
+
+		for (int stencil = 0; stencil < 2; stencil++)
+		{
+			double spacing = spacings[stencil];
+
+			double costs[2];
+			double lengths[2];
+
+			for (int axis = 0; axis < 2; axis++)
+			{
+				costs[axis] = std::numeric_limits<double>::infinity();
+				lengths[axis] = 0;
+
+				for (int side : { -1, 1 })
+				{
+					int neighbourX = x + side * stencils[stencil][axis][0];
+					int neighbourY = y + side * stencils[stencil][axis][1];
+
+					if (neighbourX < 0 || neighbourX >= resolution.width || neighbourY < 0 || neighbourY >= resolution.height)
+						continue;
+
+					int neighbour = neighbourY * resolution.width + neighbourX;
+
+					if (scratch.states[neighbour] == settled && cheaper(scratch.costs[neighbour], scratch.lengths[neighbour], costs[axis], lengths[axis]))
+					{
+						costs[axis] = scratch.costs[neighbour];
+						lengths[axis] = scratch.lengths[neighbour];
+					}
+				}
+			}
+
+			if (cheaper(costs[1], lengths[1], costs[0], lengths[0]))
+			{
+				std::swap(costs[0], costs[1]);
+				std::swap(lengths[0], lengths[1]);
+			}
+
+			if (costs[0] == std::numeric_limits<double>::infinity())
+				continue;
+
+			double step = spacing * weight;
+
+			double cost;
+			double length;
+
+			if (costs[1] - costs[0] >= step)
+			{
+				cost = costs[0] + step;
+
+				// Where the cell has no weight and both neighbours the same cost, the cost is flat and the length is marched on its own.
+				if (costs[1] == costs[0] && lengths[1] - lengths[0] < spacing)
+					length = (lengths[0] + lengths[1] + std::sqrt(2 * spacing * spacing - (lengths[0] - lengths[1]) * (lengths[0] - lengths[1]))) / 2;
+				else
+					length = lengths[0] + spacing;
+			}
+			else
+			{
+				cost = (costs[0] + costs[1] + std::sqrt(2 * step * step - (costs[0] - costs[1]) * (costs[0] - costs[1]))) / 2;
+
+				double first = cost - costs[0];
+				double second = cost - costs[1];
+
+				length = (lengths[0] * first + lengths[1] * second + spacing * step) / (first + second);
+			}
+
+			if (cheaper(cost, length, bestCost, bestLength))
+			{
+				bestCost = cost;
+				bestLength = length;
+			}
+		}
+
+		if (cheaper(bestCost, bestLength, scratch.costs[index], scratch.lengths[index]))
+		{
+			scratch.costs[index] = bestCost;
+			scratch.lengths[index] = bestLength;
+			scratch.states[index] = trial;
+
+			push(scratch.heap, bestCost, bestLength, index);
+		}
+	}
+
+	static bool cheaper(double cost, double length, double otherCost, double otherLength)
+	{
+		return cost < otherCost || (cost == otherCost && length < otherLength);
+	}
+
+	static void push(std::vector<Trial>& heap, double cost, double length, int index)
+	{
+		heap.push_back(Trial{ cost, length, index });
+		std::push_heap(heap.begin(), heap.end(), std::greater<Trial>());
+	}
+
+	// With targets the marching stops once all of them are settled; the rest of the map then holds tentative values.
+	void simulate(Position transmitterPosition, Scratch& scratch, std::vector<int> targets = std::vector<int>()) const
+	{
+		Point p = transmitterPosition.get<Distance::Unit::m>();
+		p.x += 0.0001;
+		p.y += 0.0002;
+
+		SignalMap& signalMap = *scratch.signalMap;
+		auto& heap = scratch.heap;
+
+		Point origin = signalMap.getPosition(DiscretePoint(0, 0)).get<Distance::Unit::m>();
+		double unit = signalMap.precision.get<Distance::Unit::m>();
+
+		Point source((p.x - origin.x) / unit, (p.y - origin.y) / unit);
+
+		std::fill(scratch.costs.begin(), scratch.costs.end(), std::numeric_limits<double>::infinity());
+		std::fill(scratch.lengths.begin(), scratch.lengths.end(), std::numeric_limits<double>::infinity());
+		std::fill(scratch.states.begin(), scratch.states.end(), unvisited);
+		heap.clear();
+
+		int sourceX = (int)std::floor(source.x + 0.5);
+		int sourceY = (int)std::floor(source.y + 0.5);
+
+		for (int y = std::max(0, sourceY - sourceRadius); y <= std::min(resolution.height - 1, sourceY + sourceRadius); y++)
+		{
+			for (int x = std::max(0, sourceX - sourceRadius); x <= std::min(resolution.width - 1, sourceX + sourceRadius); x++)
+			{
+				int index = y * resolution.width + x;
+				double length = std::hypot(x - source.x, y - source.y);
+
+				scratch.costs[index] = length * (absorptions[index] + detour);
+				scratch.lengths[index] = length;
+				scratch.states[index] = trial;
+
+				push(heap, scratch.costs[index], length, index);
+			}
+		}
+
+		std::sort(targets.begin(), targets.end());
+		targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+		size_t remainingTargets = targets.size();
+
+		while (!heap.empty())
+		{
+			std::pop_heap(heap.begin(), heap.end(), std::greater<Trial>());
+			Trial top = heap.back();
+			heap.pop_back();
+
+			int index = top.index;
+
+			if (scratch.states[index] == settled || cheaper(scratch.costs[index], scratch.lengths[index], top.cost, top.length))
+				continue;
+
+			scratch.states[index] = settled;
+
+			if (!targets.empty() && std::binary_search(targets.begin(), targets.end(), index) && --remainingTargets == 0)
+				break;
+
+			int x = index % resolution.width;
+			int y = index / resolution.width;
+
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					int neighbourX = x + dx;
+					int neighbourY = y + dy;
+
+					if ((dx == 0 && dy == 0) || neighbourX < 0 || neighbourX >= resolution.width || neighbourY < 0 || neighbourY >= resolution.height)
+						continue;
+
+					if (scratch.states[neighbourY * resolution.width + neighbourX] != settled)
+						update(neighbourX, neighbourY, scratch);
+				}
+			}
+		}
+
+		double scale = std::pow(frequency.get<Frequency::Unit::m>() / (4 * 3.141592653589793238463), 2);
+
+		for (int y = 0; y < resolution.height; y++)
+		{
+			for (int x = 0; x < resolution.width; x++)
+			{
+				int index = y * resolution.width + x;
+
+				double length = scratch.lengths[index] * unit;
+				double absorption = std::max(0., scratch.costs[index] - detour * std::hypot(x - source.x, y - source.y));
+
+				signalMap.getElement(DiscretePoint(x, y)) = PowerCoefficient(
+					std::isfinite(length) ? scale / (length * length) * std::exp(-absorption) : 0
+				);
+			}
+		}
+	}
+
+public:
+	EikonalSignalSimulation(SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition, Frequency frequency, EikonalSignalSimulationParameters simulationParameters) :
+		frequency(frequency),
+		simulationParameters(simulationParameters),
+		simulationSpaceDefinition(simulationSpaceDefinition),
+		resolution(
+			simulationSpaceDefinition->spaceSize.get<Distance::Unit::m>().getWidth(),
+			simulationSpaceDefinition->spaceSize.get<Distance::Unit::m>().getHeight(),
+			simulationSpaceDefinition->precision.get<Distance::Unit::m>()
+		),
+		detour(simulationParameters.detourAbsorption.get<AbsorptionCoefficient::Unit::alpha>(simulationSpaceDefinition->precision))
+	{
+		AbsorptionMap<> absorptionMap(*simulationSpaceDefinition, { { frequency } });
+
+		absorptions.resize((size_t)resolution.width * resolution.height);
+
+		for (int y = 0; y < resolution.height; y++)
+			for (int x = 0; x < resolution.width; x++)
+				absorptions[y * resolution.width + x] = std::max(0., absorptionMap.getAbsorption(DiscretePoint(x, y)).get<AbsorptionCoefficient::Unit::alpha>(simulationSpaceDefinition->precision));
+	}
+
+	virtual SignalMapPtr simulate(Position transmitterPosition) const
+	{
+		Scratch scratch(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision);
+		simulate(transmitterPosition, scratch);
+
+		return scratch.signalMap;
+	}
+
+	// Cells are settled in cost order, so the marching stops as soon as the cells of all receivers are.
+	virtual std::vector<PowerCoefficient> query(Position transmitterPosition, const std::vector<Position>& receiverPositions) const
+	{
+		Scratch scratch(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision);
+
+		std::vector<int> targets;
+
+		for (const auto& receiverPosition : receiverPositions)
+		{
+			if (!scratch.signalMap->inRange(receiverPosition))
+				continue;
+
+			DiscretePoint target = scratch.signalMap->getDiscretePoint(receiverPosition);
+			targets.push_back(target.y * resolution.width + target.x);
+		}
+
+		if (!targets.empty())
+			simulate(transmitterPosition, scratch, targets);
+
+		return sample(*scratch.signalMap, receiverPositions);
+	}
+
+	virtual void simulateBatch(const std::vector<Position>& transmitterPositions, ThreadPoolPtr threadPool, SignalMapCallback callback) const
+	{
+		runBatch<Scratch>(
+			transmitterPositions,
+			threadPool,
+			[this] { return std::unique_ptr<Scratch>(new Scratch(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision)); },
+			[this, &callback](int index, Position transmitterPosition, Scratch& scratch) {
+				simulate(transmitterPosition, scratch);
+
+				callback(index, *scratch.signalMap);
+			}
+		);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// 64-bit FNV-1a digest of everything a preprocessed space depends on.
+class Fingerprint
+{
+private:
+	uint64_t value = 14695981039346656037ull;
+
+public:
+	Fingerprint& operator<<(uint64_t data)
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			value ^= (data >> (i * 8)) & 0xff;
+			value *= 1099511628211ull;
+		}
+
+		return *this;
+	}
+
+	Fingerprint& operator<<(int data)
+	{
+		return *this << (uint64_t)(int64_t)data;
+	}
+
+	Fingerprint& operator<<(double data)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &data, sizeof(bits));
+		return *this << bits;
+	}
+
+	uint64_t get() const { return value; }
+};
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "CpuFeatures.hpp"
+
+// Free-space gain of one row of cells: gains[i] = absorptions[i] * scale / (dx * dx + dy * dy), where dx = firstDx + i * step.
+// The AVX2 version evaluates four cells at a time with the same operations, so both versions give the same result;
+// it is picked at run time, so the binary still runs on processors without AVX2.
+class FriisRowKernel
+{
+public:
+	static void evaluate(double firstDx, double step, double dy, double scale, const double* absorptions, double* gains, int count)
+	{
+#if defined(SIGNAL_MAPPER_AVX2)
+		if (supportsAvx2())
+		{
+			evaluateAvx2(firstDx, step, dy, scale, absorptions, gains, count);
+			return;
+		}
+#endif
+
+		evaluateScalar(firstDx, step, dy, scale, absorptions, gains, 0, count);
+	}
+
+private:
+	static void evaluateScalar(double firstDx, double step, double dy, double scale, const double* absorptions, double* gains, int begin, int end)
+	{
+		double dy2 = dy * dy;
+
+		for (int i = begin; i < end; i++)
+		{
+			double dx = firstDx + i * step;
+			gains[i] = absorptions[i] * scale / (dx * dx + dy2);
+		}
+	}
+
+#if defined(SIGNAL_MAPPER_AVX2)
+	SIGNAL_MAPPER_TARGET_AVX2
+	static void evaluateAvx2(double firstDx, double step, double dy, double scale, const double* absorptions, double* gains, int count)
+	{
+		const __m256d lanes = _mm256_set_pd(3, 2, 1, 0);
+		const __m256d steps = _mm256_set1_pd(step);
+		const __m256d origins = _mm256_set1_pd(firstDx);
+		const __m256d dy2 = _mm256_set1_pd(dy * dy);
+		const __m256d scales = _mm256_set1_pd(scale);
+
+		int i = 0;
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m256d dx = _mm256_add_pd(origins, _mm256_mul_pd(_mm256_add_pd(_mm256_set1_pd(i), lanes), steps));
+			__m256d distance2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), dy2);
+			__m256d gain = _mm256_div_pd(_mm256_mul_pd(_mm256_loadu_pd(absorptions + i), scales), distance2);
+
+			_mm256_storeu_pd(gains + i, gain);
+		}
+
+		evaluateScalar(firstDx, step, dy, scale, absorptions, gains, i, count);
+	}
+#endif
+};
\ No newline at end of file
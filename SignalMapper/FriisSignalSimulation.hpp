@@ -1,23 +1,31 @@
 #pragma once
 
 #include "SignalSimulation.hpp"
+#include "PenetrationMap.hpp"
+#include "FriisRowKernel.hpp"
 
 #include <vector>
 #include <algorithm>
+#include <array>
+#include <memory>
+#include <type_traits>
 
 struct FriisSignalSimulationParameters {
 	Transmitter bestTransmitter;
 	Receiver bestReceiver;
 	Power minimumPower;
+	PenetrationMethod penetrationMethod;
 
 	FriisSignalSimulationParameters(
 		Transmitter bestTransmitter,
 		Receiver bestReceiver,
-		Power minimumPower
+		Power minimumPower,
+		PenetrationMethod penetrationMethod = PenetrationMethod::exact
 	) :
 		bestTransmitter(bestTransmitter),
 		bestReceiver(bestReceiver),
-		minimumPower(minimumPower)
+		minimumPower(minimumPower),
+		penetrationMethod(penetrationMethod)
 	{ }
 };
 
@@ -29,7 +37,9 @@ struct FriisSignalSimulationDistortion
 	{}
 };
 
-class FriisSignalSimulation : public SignalSimulation
+// Bands is the number of frequencies evaluated in one pass over the obstacles; each of them gets its own signal map.
+template<size_t Bands = 1>
+class BasicFriisSignalSimulation : public SignalSimulation
 {
 private:
 	struct Ray
@@ -56,50 +66,204 @@ private:
 		{ }
 	};
 
-	const Frequency frequency;
+	const std::array<Frequency, Bands> frequencies;
 	const FriisSignalSimulationParameters simulationParameters;
 	const SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition;
 
+	std::unique_ptr<const AbsorptionMap<Bands>> absorptionMap;
+
+	struct Scratch
+	{
+		std::array<std::unique_ptr<SignalMap>, Bands> signalMaps;
+
+		Scratch(Surface surface, Distance precision)
+		{
+			for (auto& signalMap : signalMaps)
+				signalMap.reset(new SignalMap(surface, precision));
+		}
+	};
+
+	// Free-space gain at a distance of one metre, for every band.
+	std::array<double, Bands> getScales() const
+	{
+		std::array<double, Bands> scales;
+
+		for (size_t band = 0; band < Bands; band++)
+		{
+			Frequency frequency = frequencies[band];
+			scales[band] = std::pow(frequency.get<Frequency::Unit::m>() / (4 * 3.141592653589793238463), 2);
+		}
+
+		return scales;
+	}
+
+	// Every cell gets assigned, so the maps do not have to be cleared beforehand.
+	// The absorption of a row is collected first, then the free-space loss of the whole row is applied by the row kernel.
+	void simulate(Position transmitterPosition, const std::array<SignalMap*, Bands>& signalMaps) const
+	{
+		Point p = transmitterPosition.get<Distance::Unit::m>();
+		p.x += 0.0001;
+		p.y += 0.0002;
+		transmitterPosition = Position::in<Distance::Unit::m>(p);
+
+		const SignalMap& grid = *signalMaps[0];
+		int width = grid.resolution.width;
+
+		std::unique_ptr<PenetrationMap<Bands>> penetrationMap;
+
+		if (absorptionMap)
+		{
+			penetrationMap.reset(new PenetrationMap<Bands>(grid.surface, grid.precision));
+			absorptionMap->sweep(transmitterPosition, *penetrationMap);
+		}
+
+		Point origin = grid.getPosition(DiscretePoint(0, 0)).get<Distance::Unit::m>();
+		double step = grid.precision.get<Distance::Unit::m>();
+
+		std::array<double, Bands> scales = getScales();
+
+		std::array<std::vector<double>, Bands> absorptions;
+		for (auto& row : absorptions)
+			row.resize(width);
+
+		std::vector<double> gains(width);
+
+		for (int y = 0; y < grid.resolution.height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				DiscretePoint discretePosition(x, y);
+
+				if (penetrationMap)
+				{
+					const Penetration<Bands>& penetration = penetrationMap->getElement(discretePosition);
+
+					for (size_t band = 0; band < Bands; band++)
+						absorptions[band][x] = penetration.depth[band] != 0 ? std::exp(-penetration.depth[band]) : 1;
+
+					continue;
+				}
+
+				Position position = grid.getPosition(discretePosition);
+				Distance distance = transmitterPosition.distanceTo(position);
+
+				for (size_t band = 0; band < Bands; band++)
+					absorptions[band][x] = 1;
+
+				simulationSpaceDefinition->forEachObstacle(transmitterPosition, position, [&](const ObstaclePtr& obstacle) {
+					auto obstacleAbsorptions = obstacle->absorption(transmitterPosition, position, frequencies);
+
+					for (size_t band = 0; band < Bands; band++)
+						absorptions[band][x] *= obstacleAbsorptions[band].template get<AbsorptionCoefficient::Unit::coefficient>(distance);
+				});
+			}
+
+			for (size_t band = 0; band < Bands; band++)
+			{
+				FriisRowKernel::evaluate(origin.x - p.x, step, origin.y + step * y - p.y, scales[band], absorptions[band].data(), gains.data(), width);
+
+				for (int x = 0; x < width; x++)
+					signalMaps[band]->getElement(DiscretePoint(x, y)) = PowerCoefficient(gains[x]);
+			}
+		}
+	}
+
 public:
-	FriisSignalSimulation(SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition, Frequency frequency, FriisSignalSimulationParameters simulationParameters) :
+	BasicFriisSignalSimulation(SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition, const std::array<Frequency, Bands>& frequencies, FriisSignalSimulationParameters simulationParameters) :
 		simulationSpaceDefinition(simulationSpaceDefinition),
-		frequency(frequency),
+		frequencies(frequencies),
 		simulationParameters(simulationParameters)
+	{
+		if (simulationParameters.penetrationMethod == PenetrationMethod::sweep)
+			absorptionMap.reset(new AbsorptionMap<Bands>(*simulationSpaceDefinition, frequencies));
+	}
+
+	template<size_t B = Bands, typename = typename std::enable_if<B == 1>::type>
+	BasicFriisSignalSimulation(SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition, Frequency frequency, FriisSignalSimulationParameters simulationParameters) :
+		BasicFriisSignalSimulation(simulationSpaceDefinition, std::array<Frequency, Bands>{ { frequency } }, simulationParameters)
 	{ }
 
 	virtual SignalMapPtr simulate(Position transmitterPosition) const
+	{
+		return simulateBands(transmitterPosition)[0];
+	}
+
+	std::array<SignalMapPtr, Bands> simulateBands(Position transmitterPosition) const
+	{
+		std::array<SignalMapPtr, Bands> signalMaps;
+		std::array<SignalMap*, Bands> targets;
+
+		for (size_t band = 0; band < Bands; band++)
+		{
+			auto signalMap = std::make_shared<SignalMap>(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision);
+			signalMaps[band] = signalMap;
+			targets[band] = signalMap.get();
+		}
+
+		simulate(transmitterPosition, targets);
+
+		return signalMaps;
+	}
+
+	virtual std::vector<PowerCoefficient> query(Position transmitterPosition, const std::vector<Position>& receiverPositions) const
+	{
+		return queryBands(transmitterPosition, receiverPositions)[0];
+	}
+
+	// Evaluates only the transmitter-receiver lines, at the exact receiver positions rather than at their cells.
+	// The lines are always intersected with the obstacles exactly, as a sweep would cost as much as a whole map.
+	std::array<std::vector<PowerCoefficient>, Bands> queryBands(Position transmitterPosition, const std::vector<Position>& receiverPositions) const
 	{
 		Point p = transmitterPosition.get<Distance::Unit::m>();
 		p.x += 0.0001;
 		p.y += 0.0002;
 		transmitterPosition = Position::in<Distance::Unit::m>(p);
 
-		auto signalMap = std::make_shared<SignalMap>(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision);
-		auto minimumCoefficient =
-			simulationParameters.minimumPower /
-			(simulationParameters.bestTransmitter.power *
-				simulationParameters.bestTransmitter.antenaGain *
-				simulationParameters.bestReceiver.antenaGain);
+		std::array<double, Bands> scales = getScales();
+		std::array<std::vector<PowerCoefficient>, Bands> powerCoefficients;
 
-		for (int x = 0; x < signalMap->resolution.width; x++)
+		for (const auto& receiverPosition : receiverPositions)
 		{
-			for (int y = 0; y < signalMap->resolution.height; y++)
-			{
-				DiscretePoint discretePosition(x, y);
-				Position position = signalMap->getPosition(discretePosition);
-				Distance distance = transmitterPosition.distanceTo(position);
+			Distance distance = transmitterPosition.distanceTo(receiverPosition);
 
-				PowerCoefficient powerCoefficient = PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(1);
+			std::array<double, Bands> absorptions;
+			absorptions.fill(1);
 
-				for (const auto& obstacle : simulationSpaceDefinition->obstacles)
-				{
-					powerCoefficient = powerCoefficient * obstacle->absorption(transmitterPosition, position, frequency).get<AbsorptionCoefficient::Unit::coefficient>(distance);
-				}
+			simulationSpaceDefinition->forEachObstacle(transmitterPosition, receiverPosition, [&](const ObstaclePtr& obstacle) {
+				auto obstacleAbsorptions = obstacle->absorption(transmitterPosition, receiverPosition, frequencies);
 
-				signalMap->getElement(discretePosition) = powerCoefficient * std::pow(frequency / (distance * 4 * 3.141592653589793238463), 2);
-			}
+				for (size_t band = 0; band < Bands; band++)
+					absorptions[band] *= obstacleAbsorptions[band].template get<AbsorptionCoefficient::Unit::coefficient>(distance);
+			});
+
+			double distance2 = std::pow(distance.get<Distance::Unit::m>(), 2);
+
+			for (size_t band = 0; band < Bands; band++)
+				powerCoefficients[band].push_back(PowerCoefficient(absorptions[band] * scales[band] / distance2));
 		}
 
-		return signalMap;
+		return powerCoefficients;
+	}
+
+	// With several bands the map of the given band of transmitter i is reported under index i * Bands + band.
+	virtual void simulateBatch(const std::vector<Position>& transmitterPositions, ThreadPoolPtr threadPool, SignalMapCallback callback) const
+	{
+		runBatch<Scratch>(
+			transmitterPositions,
+			threadPool,
+			[this] { return std::unique_ptr<Scratch>(new Scratch(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision)); },
+			[this, &callback](int index, Position transmitterPosition, Scratch& scratch) {
+				std::array<SignalMap*, Bands> targets;
+
+				for (size_t band = 0; band < Bands; band++)
+					targets[band] = scratch.signalMaps[band].get();
+
+				simulate(transmitterPosition, targets);
+
+				for (size_t band = 0; band < Bands; band++)
+					callback(index * (int)Bands + (int)band, *scratch.signalMaps[band]);
+			}
+		);
 	}
-};
\ No newline at end of file
+};
+using FriisSignalSimulation = BasicFriisSignalSimulation<1>;
\ No newline at end of file
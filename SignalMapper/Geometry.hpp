@@ -1,16 +1,36 @@
 #pragma once
 
 #include "Math.hpp"
+#include "BoundingVolumeHierarchy.hpp"
+#include "Fingerprint.hpp"
 
 #include <vector>
 #include <limits>
 #include <memory>
 #include <functional>
+#include <algorithm>
+
+struct Span
+{
+	double begin;
+	double end;
+
+	Span(double begin, double end) :
+		begin(begin), end(end)
+	{ }
+};
+using Spans = std::vector<Span>;
 
 struct SolidShape
 {
 	virtual bool contains(Point point) const = 0;
 	virtual void intersections(Vector ray, std::function<void(const Intersection&)>&& callback) const = 0;
+	virtual Rectangle getBounds() const = 0;
+	virtual void edges(std::function<void(const Line&)>&& callback) const = 0;
+	virtual void fingerprint(Fingerprint& fingerprint) const = 0;
+
+	// Reports, for every row y + step * row within [firstRow, lastRow), the sorted and disjoint x spans lying inside the shape.
+	virtual void rasterize(double y, double step, int firstRow, int lastRow, std::function<void(int, const Spans&)>&& callback) const = 0;
 };
 using SolidShapePtr = std::shared_ptr<const SolidShape>;
 
@@ -22,8 +42,18 @@ class CSGShape : public SolidShape
 struct Polygon : public SolidShape
 {
 private:
+	struct ScanlineEdge
+	{
+		double minY;
+		double maxY;
+		double x;
+		double slope;
+	};
+
 	Rectangle bounds;
 	std::vector<Point> points;
+	BoundingVolumeHierarchy edgesHierarchy;
+	std::vector<ScanlineEdge> edgeTable;
 
 public:
 	Polygon(const std::vector<Point>& points) :
@@ -34,25 +64,72 @@ public:
 		double
 			minX = std::numeric_limits<double>::max(),
 			minY = std::numeric_limits<double>::max(),
-			maxX = std::numeric_limits<double>::min(),
-			maxY = std::numeric_limits<double>::min();
+			maxX = std::numeric_limits<double>::lowest(),
+			maxY = std::numeric_limits<double>::lowest();
 
 		for (const auto& p : points)
 		{
 			minX = std::min(minX, p.x);
 			minY = std::min(minY, p.y);
-			maxX = std::max(minX, p.x);
-			maxY = std::max(minY, p.y);
+			maxX = std::max(maxX, p.x);
+			maxY = std::max(maxY, p.y);
 		}
 
 		bounds = Rectangle(
 			Point(minX, minY),
 			Point(maxX, maxY)
 		);
+
+		std::vector<Rectangle> edgesBounds;
+
+		for (int i = 0; i < this->points.size() - 1; i++)
+			edgesBounds.push_back(Rectangle(this->points[i], this->points[i + 1]));
+
+		edgesHierarchy = BoundingVolumeHierarchy(edgesBounds);
+
+		for (int i = 0; i < this->points.size() - 1; i++)
+		{
+			Point a = this->points[i];
+			Point b = this->points[i + 1];
+
+			if (a.y == b.y)
+				continue;
+
+			if (a.y > b.y)
+				std::swap(a, b);
+
+			edgeTable.push_back({ a.y, b.y, a.x, (b.x - a.x) / (b.y - a.y) });
+		}
+
+		std::sort(edgeTable.begin(), edgeTable.end(), [](const ScanlineEdge& a, const ScanlineEdge& b) {
+			return a.minY < b.minY;
+		});
+	}
+
+	virtual Rectangle getBounds() const
+	{
+		return bounds;
+	}
+
+	virtual void edges(std::function<void(const Line&)>&& callback) const
+	{
+		for (int i = 0; i < points.size() - 1; i++)
+			callback(Line(points[i], points[i + 1]));
+	}
+
+	virtual void fingerprint(Fingerprint& fingerprint) const
+	{
+		fingerprint << (int)points.size();
+
+		for (const auto& point : points)
+			fingerprint << point.x << point.y;
 	}
 
 	virtual bool contains(Point point) const
 	{
+		if (point.x < bounds.minX() || point.x > bounds.maxX() || point.y < bounds.minY() || point.y > bounds.maxY())
+			return false;
+
 		double alpha = 0.123;
 
 		Vector ray(
@@ -73,9 +150,15 @@ public:
 	virtual void intersections(Vector ray, std::function<void(const Intersection&)>&& callback) const
 	{
 		double previousDotProduct = 0;
+		int previousEdge = -1;
 
-		for (int i = 0; i < points.size() - 1; i++)
+		edgesHierarchy.traverse(ray, [this, &ray, &callback, &previousDotProduct, &previousEdge](int i)
 		{
+			if (i != previousEdge + 1)
+				previousDotProduct = 0;
+
+			previousEdge = i;
+
 			Line wallLine(
 				points[i],
 				points[i + 1]
@@ -97,6 +180,43 @@ public:
 			{
 				previousDotProduct = 0;
 			}
+		});
+	}
+
+	virtual void rasterize(double y, double step, int firstRow, int lastRow, std::function<void(int, const Spans&)>&& callback) const
+	{
+		std::vector<const ScanlineEdge*> activeEdges;
+		std::vector<double> crossings;
+		Spans spans;
+
+		int nextEdge = 0;
+
+		for (int row = firstRow; row < lastRow; row++)
+		{
+			double rowY = y + step * row;
+
+			while (nextEdge < edgeTable.size() && edgeTable[nextEdge].minY <= rowY)
+				activeEdges.push_back(&edgeTable[nextEdge++]);
+
+			activeEdges.erase(
+				std::remove_if(activeEdges.begin(), activeEdges.end(), [rowY](const ScanlineEdge* edge) { return edge->maxY <= rowY; }),
+				activeEdges.end()
+			);
+
+			if (activeEdges.empty())
+				continue;
+
+			crossings.clear();
+			for (const auto* edge : activeEdges)
+				crossings.push_back(edge->x + (rowY - edge->minY) * edge->slope);
+
+			std::sort(crossings.begin(), crossings.end());
+
+			spans.clear();
+			for (int i = 0; i + 1 < crossings.size(); i += 2)
+				spans.push_back(Span(crossings[i], crossings[i + 1]));
+
+			callback(row, spans);
 		}
 	}
 };
@@ -110,6 +230,24 @@ struct CSGShapesDifference : public CSGShape
 		shapeA(shapeA), shapeB(shapeB)
 	{ }
 
+	virtual Rectangle getBounds() const
+	{
+		return shapeA->getBounds();
+	}
+
+	virtual void edges(std::function<void(const Line&)>&& callback) const
+	{
+		shapeA->edges([&callback](const Line& line) { callback(line); });
+		shapeB->edges([&callback](const Line& line) { callback(line); });
+	}
+
+	virtual void fingerprint(Fingerprint& fingerprint) const
+	{
+		fingerprint << -1;
+		shapeA->fingerprint(fingerprint);
+		shapeB->fingerprint(fingerprint);
+	}
+
 	virtual bool contains(Point point) const
 	{
 		return shapeA->contains(point) && !shapeB->contains(point);
@@ -135,4 +273,43 @@ struct CSGShapesDifference : public CSGShape
 				callback(-intersection);
 		});
 	}
+
+	virtual void rasterize(double y, double step, int firstRow, int lastRow, std::function<void(int, const Spans&)>&& callback) const
+	{
+		std::vector<Spans> subtractedRows(std::max(0, lastRow - firstRow));
+
+		shapeB->rasterize(y, step, firstRow, lastRow, [&subtractedRows, firstRow](int row, const Spans& spans) {
+			subtractedRows[row - firstRow] = spans;
+		});
+
+		Spans difference;
+
+		shapeA->rasterize(y, step, firstRow, lastRow, [&subtractedRows, &difference, &callback, firstRow](int row, const Spans& spans) {
+			const Spans& subtracted = subtractedRows[row - firstRow];
+
+			difference.clear();
+
+			int s = 0;
+
+			for (Span span : spans)
+			{
+				while (s < subtracted.size() && subtracted[s].end <= span.begin)
+					s++;
+
+				for (int i = s; i < subtracted.size() && subtracted[i].begin < span.end; i++)
+				{
+					if (subtracted[i].begin > span.begin)
+						difference.push_back(Span(span.begin, subtracted[i].begin));
+
+					span.begin = std::max(span.begin, subtracted[i].end);
+				}
+
+				if (span.begin < span.end)
+					difference.push_back(span);
+			}
+
+			if (!difference.empty())
+				callback(row, difference);
+		});
+	}
 };
\ No newline at end of file
@@ -0,0 +1,792 @@
+#pragma once
+
+#include "SignalSimulation.hpp"
+#include "ThreadPool.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <memory>
+#include <initializer_list>
+#include <utility>
+
+struct ImageSourceSignalSimulationParameters {
+	int reflectionCount;
+	Transmitter bestTransmitter;
+	Receiver bestReceiver;
+	Power minimumPower;
+	ThreadPoolPtr threadPool;
+
+	ImageSourceSignalSimulationParameters(
+		int reflectionCount,
+		Transmitter bestTransmitter,
+		Receiver bestReceiver,
+		Power minimumPower,
+		ThreadPoolPtr threadPool = nullptr
+	) :
+		reflectionCount(reflectionCount),
+		bestTransmitter(bestTransmitter),
+		bestReceiver(bestReceiver),
+		minimumPower(minimumPower),
+		threadPool(threadPool)
+	{ }
+};
+
+// Specular reflections found exactly with the image-source method. Every edge of the obstacles is a mirror; the transmitter
+// is mirrored over every wall it is in front of, those images over every wall they are in front of, and so on up to
+// reflectionCount reflections. Each image only sees the walls through the aperture of its parent (beam tracing), and
+// images whose strongest possible contribution is below the minimum power are dropped with all of their children.
+// The walls that stand between the parent and the aperture do not block the beam, but every obstacle it has to cross
+// lowers that strongest contribution, so occluded parts of the aperture are cut off and the images behind them are dropped.
+// A cell gets the powers of all images that reach it summed up: the free-space loss over the unfolded path, the reflection
+// of every wall and the absorption of the obstacles crossed by every leg of the path. The absorption is taken from the crossings
+// of the walls, each with the material just behind it. Every image keeps the walls that touch the triangle from its parent
+// to its aperture and the part of its beam within its range, so a leg costs a few segment intersections.
+// Obstacles are assumed not to overlap. This is the accurate engine, not the fast one: every cell is evaluated against every
+// image that covers it, which takes about twice as long as the raycaster does for the same number of reflections.
+class ImageSourceSignalSimulation : public SignalSimulation
+{
+private:
+	struct Wall
+	{
+		Point a, b;
+		// Unit normal pointing out of the obstacle, toward the side from which the wall reflects.
+		FreeVector normalVector;
+		double reflection;
+		// Absorption of the material behind the wall in nepers per metre.
+		double absorption;
+	};
+
+	// Points with (point - origin) * normalVector >= 0 are inside.
+	struct HalfPlane
+	{
+		Point origin;
+		FreeVector normalVector;
+
+		double value(Point point) const { return FreeVector(origin, point) * normalVector; }
+	};
+
+	// The direct path is the image without a wall; the others cover the part of the plane seen
+	// from the image through the aperture on its wall.
+	struct Image
+	{
+		Point position;
+		int wall;
+		int parent;
+		double reflection;
+		// Least absorption in nepers that any path of the image meets before it leaves its wall.
+		double attenuation = 0;
+		// Squared distance beyond which the image cannot reach the minimum power.
+		double range;
+
+		int halfPlanesCount = 0;
+		HalfPlane halfPlanes[3];
+
+		Point apertureA, apertureB;
+
+		// Walls that the leg coming to the wall of the image and the leg leaving it toward a receiver can cross,
+		// as ranges of ImageTree::blockers.
+		int incomingBegin = 0, incomingEnd = 0;
+		int outgoingBegin = 0, outgoingEnd = 0;
+
+		bool covers(Point point) const
+		{
+			for (int i = 0; i < halfPlanesCount; i++)
+				if (halfPlanes[i].value(point) < 0)
+					return false;
+
+			return true;
+		}
+	};
+
+	struct ImageTree
+	{
+		std::vector<Image> images;
+		std::vector<int> blockers;
+		// Absorption in nepers per metre of the obstacles that contain the transmitter.
+		double sourceAbsorption = 0;
+	};
+
+	// Reflection points are moved this far off the wall, so the legs do not start on the boundary of the obstacle.
+	static constexpr double offset = 1e-6;
+	static const int rowsPerTask = 8;
+
+	const Frequency frequency;
+	const ImageSourceSignalSimulationParameters simulationParameters;
+	const SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition;
+
+	std::vector<Wall> walls;
+
+	PowerCoefficient getMinimumCoefficient() const
+	{
+		return
+			simulationParameters.minimumPower /
+			(simulationParameters.bestTransmitter.power *
+				simulationParameters.bestTransmitter.antenaGain *
+				simulationParameters.bestReceiver.antenaGain);
+	}
+
+	double getScale() const
+	{
+		return std::pow(frequency.get<Frequency::Unit::m>() / (4 * 3.141592653589793238463), 2);
+	}
+
+	// Absorption of the obstacle in nepers per metre at a point inside of it.
+	double getAbsorption(const Obstacle& obstacle, Point point) const
+	{
+		Position begin = Position::in<Distance::Unit::m>(point);
+		Position end = Position::in<Distance::Unit::m>(Point(point.x + offset, point.y));
+
+		return obstacle.absorption(begin, end, frequency).get<AbsorptionCoefficient::Unit::alpha>(Distance::in<Distance::Unit::m>(1));
+	}
+
+	static Point mirror(Point point, const Wall& wall)
+	{
+		double distance = FreeVector(wall.a, point) * wall.normalVector;
+		return point + wall.normalVector * (-2 * distance);
+	}
+
+	static HalfPlane halfPlane(Point a, Point b, Point inside)
+	{
+		HalfPlane plane{ a, FreeVector(a, b).transposed() };
+
+		if (plane.value(inside) < 0)
+			plane.normalVector = -plane.normalVector;
+
+		return plane;
+	}
+
+	static double distanceToSegment(Point point, Point a, Point b)
+	{
+		FreeVector segment(a, b);
+		double length = segment * segment;
+		double t = length > 0 ? std::max(0., std::min(1., FreeVector(a, point) * segment / length)) : 0;
+
+		return FreeVector(a + segment * t, point).d();
+	}
+
+	// Cuts the part of the a-b segment that lies in all half-planes of the image; false if nothing is left.
+	static bool clip(const Image& image, Point& a, Point& b)
+	{
+		double begin = 0;
+		double end = 1;
+
+		for (int i = 0; i < image.halfPlanesCount; i++)
+		{
+			double first = image.halfPlanes[i].value(a);
+			double second = image.halfPlanes[i].value(b);
+
+			if (first < 0 && second < 0)
+				return false;
+
+			if (first < 0)
+				begin = std::max(begin, first / (first - second));
+			else if (second < 0)
+				end = std::min(end, first / (first - second));
+		}
+
+		if (end - begin <= 0)
+			return false;
+
+		FreeVector segment(a, b);
+		Point clippedA = a + segment * begin;
+		Point clippedB = a + segment * end;
+
+		a = clippedA;
+		b = clippedB;
+
+		return FreeVector(a, b).d() > offset;
+	}
+
+	// Finds the part of the wall that lies in all of the half-planes loosened by the offset, as fractions of the wall;
+	// false if nothing is left. Loosened so that the lists of blockers built with it never miss a crossing.
+	static bool cut(const HalfPlane* halfPlanes, int halfPlanesCount, const Wall& wall, double& begin, double& end)
+	{
+		begin = 0;
+		end = 1;
+
+		for (int i = 0; i < halfPlanesCount; i++)
+		{
+			double first = halfPlanes[i].value(wall.a) + offset;
+			double second = halfPlanes[i].value(wall.b) + offset;
+
+			if (first < 0 && second < 0)
+				return false;
+
+			if (first < 0)
+				begin = std::max(begin, first / (first - second));
+			else if (second < 0)
+				end = std::min(end, first / (first - second));
+		}
+
+		return begin <= end;
+	}
+
+	// Whether a leg leaving the image toward a receiver it covers and can reach may cross the wall:
+	// some part of the wall has to lie in the beam and within the range of the image.
+	static bool reaches(const Image& image, const Wall& wall)
+	{
+		double begin, end;
+
+		if (!cut(image.halfPlanes, image.halfPlanesCount, wall, begin, end))
+			return false;
+
+		FreeVector segment(wall.a, wall.b);
+		double distance = distanceToSegment(image.position, wall.a + segment * begin, wall.a + segment * end) - offset;
+
+		return distance <= 0 || distance * distance <= image.range;
+	}
+
+	// Distance between two walls that do not cross each other.
+	static double distanceBetween(const Wall& first, const Wall& second)
+	{
+		return std::min(
+			std::min(distanceToSegment(first.a, second.a, second.b), distanceToSegment(first.b, second.a, second.b)),
+			std::min(distanceToSegment(second.a, first.a, first.b), distanceToSegment(second.b, first.a, first.b)));
+	}
+
+	// Cuts the aperture of the image to the parts that the beam of the parent reaches through the occluding walls,
+	// from the first to the last of them, and sets the attenuation and the range of the image; false if no part is left.
+	// The aperture is split where the occluders end as seen from the parent, so each part of the beam crosses the same walls.
+	// Inside of an obstacle a path runs at least the distance between the wall it enters through and the wall it leaves through,
+	// which bounds the absorption of the part from below; parts that are still too far from the image for that bound are dropped.
+	bool occlude(const ImageTree& tree, const Image& parentImage, Image& image, double scale, double minimumCoefficient, std::vector<double>& breakpoints, std::vector<std::pair<double, int>>& crossings) const
+	{
+		Point origin = parentImage.position;
+		Point apertureA = image.apertureA;
+		FreeVector aperture(image.apertureA, image.apertureB);
+		FreeVector toOrigin(apertureA, origin);
+
+		breakpoints.clear();
+		breakpoints.push_back(0);
+		breakpoints.push_back(1);
+
+		for (int i = image.incomingBegin; i < image.incomingEnd; i++)
+		{
+			const Wall& wall = walls[tree.blockers[i]];
+
+			for (Point end : { wall.a, wall.b })
+			{
+				FreeVector direction(origin, end);
+				double divider = aperture.dx * direction.dy - aperture.dy * direction.dx;
+
+				if (divider == 0)
+					continue;
+
+				double u = (toOrigin.dx * direction.dy - toOrigin.dy * direction.dx) / divider;
+				double k = (toOrigin.dx * aperture.dy - toOrigin.dy * aperture.dx) / divider;
+
+				if (k > 0 && u > 0 && u < 1)
+					breakpoints.push_back(u);
+			}
+		}
+
+		std::sort(breakpoints.begin(), breakpoints.end());
+
+		double first = 1;
+		double last = 0;
+		double attenuation = std::numeric_limits<double>::infinity();
+
+		for (size_t i = 1; i < breakpoints.size(); i++)
+		{
+			double begin = breakpoints[i - 1];
+			double end = breakpoints[i];
+
+			if (end - begin <= 0)
+				continue;
+
+			FreeVector ray(origin, apertureA + aperture * ((begin + end) / 2));
+
+			// The leg starts where the ray leaves the wall of the parent.
+			double start = 0;
+
+			if (parentImage.wall >= 0)
+			{
+				const Wall& wall = walls[parentImage.wall];
+				FreeVector segment(wall.a, wall.b);
+				FreeVector toWall(origin, wall.a);
+
+				start = (toWall.dx * segment.dy - toWall.dy * segment.dx) / (ray.dx * segment.dy - ray.dy * segment.dx);
+			}
+
+			crossings.clear();
+
+			for (int j = image.incomingBegin; j < image.incomingEnd; j++)
+			{
+				int w = tree.blockers[j];
+
+				if (w == image.wall || w == parentImage.wall)
+					continue;
+
+				const Wall& wall = walls[w];
+
+				FreeVector segment(wall.a, wall.b);
+				double divider = ray.dx * segment.dy - ray.dy * segment.dx;
+
+				if (divider == 0)
+					continue;
+
+				FreeVector toWall(origin, wall.a);
+
+				double t = (toWall.dx * segment.dy - toWall.dy * segment.dx) / divider;
+				double s = (toWall.dx * ray.dy - toWall.dy * ray.dx) / divider;
+
+				if (t > start && t < 1 && s >= 0 && s <= 1)
+					crossings.push_back(std::make_pair(t, w));
+			}
+
+			std::sort(crossings.begin(), crossings.end());
+
+			double depth = parentImage.attenuation;
+			int entered = -1;
+
+			for (const auto& crossing : crossings)
+			{
+				const Wall& wall = walls[crossing.second];
+
+				if (wall.normalVector * ray < 0)
+					entered = crossing.second;
+				else if (entered >= 0)
+				{
+					depth += walls[entered].absorption * distanceBetween(walls[entered], wall);
+					entered = -1;
+				}
+			}
+
+			double range = image.reflection * scale * std::exp(-depth) / minimumCoefficient;
+
+			if (std::pow(distanceToSegment(image.position, apertureA + aperture * begin, apertureA + aperture * end), 2) > range)
+				continue;
+
+			first = std::min(first, begin);
+			last = std::max(last, end);
+			attenuation = std::min(attenuation, depth);
+		}
+
+		if (first >= last)
+			return false;
+
+		image.apertureA = apertureA + aperture * first;
+		image.apertureB = apertureA + aperture * last;
+		image.attenuation = attenuation;
+		image.range = image.reflection * scale * std::exp(-attenuation) / minimumCoefficient;
+
+		return FreeVector(image.apertureA, image.apertureB).d() > offset;
+	}
+
+	// Walls that touch the bounding box of the points.
+	void collectBlockers(std::initializer_list<Point> points, std::vector<int>& blockers) const
+	{
+		double minX = std::numeric_limits<double>::infinity(), maxX = -minX;
+		double minY = minX, maxY = -minX;
+
+		for (const auto& point : points)
+		{
+			minX = std::min(minX, point.x - offset);
+			maxX = std::max(maxX, point.x + offset);
+			minY = std::min(minY, point.y - offset);
+			maxY = std::max(maxY, point.y + offset);
+		}
+
+		for (size_t w = 0; w < walls.size(); w++)
+		{
+			const Wall& wall = walls[w];
+
+			if (std::max(wall.a.x, wall.b.x) >= minX && std::min(wall.a.x, wall.b.x) <= maxX &&
+				std::max(wall.a.y, wall.b.y) >= minY && std::min(wall.a.y, wall.b.y) <= maxY)
+				blockers.push_back((int)w);
+		}
+	}
+
+	ImageTree buildImages(Point source) const
+	{
+		double minimumCoefficient = getMinimumCoefficient().get<PowerCoefficient::Unit::coefficient>();
+		double scale = getScale();
+
+		ImageTree tree;
+		auto& images = tree.images;
+		auto& blockers = tree.blockers;
+
+		for (const auto& obstacle : simulationSpaceDefinition->obstacles)
+			if (obstacle->inside(Position::in<Distance::Unit::m>(source)))
+				tree.sourceAbsorption += getAbsorption(*obstacle, source);
+
+		Image direct;
+		direct.position = source;
+		direct.wall = -1;
+		direct.parent = -1;
+		direct.reflection = 1;
+		direct.range = scale / minimumCoefficient;
+
+		for (size_t w = 0; w < walls.size(); w++)
+			if (reaches(direct, walls[w]))
+				blockers.push_back((int)w);
+
+		direct.outgoingEnd = (int)blockers.size();
+
+		images.push_back(direct);
+
+		std::vector<double> breakpoints;
+		std::vector<std::pair<double, int>> crossings;
+
+		size_t generationBegin = 0;
+
+		for (int order = 0; order < simulationParameters.reflectionCount; order++)
+		{
+			size_t generationEnd = images.size();
+
+			for (size_t parent = generationBegin; parent < generationEnd; parent++)
+			{
+				for (size_t w = 0; w < walls.size(); w++)
+				{
+					const Image& parentImage = images[parent];
+					const Wall& wall = walls[w];
+
+					if ((int)w == parentImage.wall || FreeVector(wall.a, parentImage.position) * wall.normalVector <= 0)
+						continue;
+
+					double reflection = parentImage.reflection * wall.reflection;
+
+					if (reflection == 0)
+						continue;
+
+					Point apertureA = wall.a;
+					Point apertureB = wall.b;
+
+					if (!clip(parentImage, apertureA, apertureB))
+						continue;
+
+					Image image;
+					image.position = mirror(parentImage.position, wall);
+					image.wall = (int)w;
+					image.parent = (int)parent;
+					image.reflection = reflection;
+					image.range = reflection * scale / minimumCoefficient;
+					image.apertureA = apertureA;
+					image.apertureB = apertureB;
+
+					if (std::pow(distanceToSegment(image.position, apertureA, apertureB), 2) > image.range)
+						continue;
+
+					image.incomingBegin = (int)blockers.size();
+
+					if (parentImage.wall < 0)
+						collectBlockers({ source, apertureA, apertureB }, blockers);
+					else
+						collectBlockers({ parentImage.apertureA, parentImage.apertureB, apertureA, apertureB }, blockers);
+
+					image.incomingEnd = (int)blockers.size();
+
+					if (!occlude(tree, parentImage, image, scale, minimumCoefficient, breakpoints, crossings))
+					{
+						blockers.resize(image.incomingBegin);
+						continue;
+					}
+
+					// The incoming leg runs from the parent to what is left of the aperture, so only the walls touching that triangle are kept.
+					HalfPlane triangle[3] = {
+						halfPlane(parentImage.position, image.apertureA, image.apertureB),
+						halfPlane(parentImage.position, image.apertureB, image.apertureA),
+						halfPlane(image.apertureA, image.apertureB, parentImage.position)
+					};
+
+					int incomingEnd = image.incomingBegin;
+
+					for (int i = image.incomingBegin; i < image.incomingEnd; i++)
+					{
+						double begin, end;
+
+						if (cut(triangle, 3, walls[blockers[i]], begin, end))
+							blockers[incomingEnd++] = blockers[i];
+					}
+
+					blockers.resize(incomingEnd);
+					image.incomingEnd = incomingEnd;
+
+					image.halfPlanesCount = 3;
+					image.halfPlanes[0] = halfPlane(image.position, image.apertureA, image.apertureB);
+					image.halfPlanes[1] = halfPlane(image.position, image.apertureB, image.apertureA);
+					image.halfPlanes[2] = halfPlane(image.apertureA, image.apertureB, parentImage.position);
+
+					image.outgoingBegin = image.incomingEnd;
+
+					for (size_t blocker = 0; blocker < walls.size(); blocker++)
+						if (reaches(image, walls[blocker]))
+							blockers.push_back((int)blocker);
+
+					image.outgoingEnd = (int)blockers.size();
+
+					images.push_back(image);
+				}
+			}
+
+			generationBegin = generationEnd;
+		}
+
+		return tree;
+	}
+
+	// Absorption in nepers along the begin-end leg, which starts outside of the obstacles. Like UniformObstacle::absorption,
+	// every wall the leg enters adds the rest of the leg behind it and every wall it leaves takes it away.
+	double absorption(const ImageTree& tree, int first, int last, Point begin, Point end) const
+	{
+		FreeVector leg(begin, end);
+		double length = leg.d();
+		double depth = 0;
+
+		for (int i = first; i < last; i++)
+		{
+			const Wall& wall = walls[tree.blockers[i]];
+
+			FreeVector segment(wall.a, wall.b);
+			double divider = leg.dx * segment.dy - leg.dy * segment.dx;
+
+			if (divider == 0)
+				continue;
+
+			FreeVector toWall(begin, wall.a);
+
+			double t = (toWall.dx * segment.dy - toWall.dy * segment.dx) / divider;
+			double s = (toWall.dx * leg.dy - toWall.dy * leg.dx) / divider;
+
+			if (t <= 0 || t > 1 || s < 0 || s > 1)
+				continue;
+
+			double behind = wall.absorption * (1 - t) * length;
+			depth += wall.normalVector * leg < 0 ? behind : -behind;
+		}
+
+		return depth;
+	}
+
+	// Power coefficient of the path of the image to the receiver, or 0 if there is no such path or it is too weak.
+	// The path is unfolded backwards: from the receiver toward the image, through the wall of the image, then toward its parent.
+	double evaluate(const ImageTree& tree, int index, Point receiver, double scale, double minimumCoefficient) const
+	{
+		const auto& images = tree.images;
+		const Image& image = images[index];
+
+		double coefficient = image.reflection * scale / (std::pow(receiver.x - image.position.x, 2) + std::pow(receiver.y - image.position.y, 2));
+
+		if (coefficient < minimumCoefficient)
+			return 0;
+
+		// The path is dropped as soon as its absorption takes it below the minimum.
+		double budget = std::log(coefficient / minimumCoefficient);
+		double depth = 0;
+
+		Point target = receiver;
+		int first = image.outgoingBegin;
+		int last = image.outgoingEnd;
+
+		for (int i = index; images[i].wall >= 0; i = images[i].parent)
+		{
+			const Image& current = images[i];
+			const Wall& wall = walls[current.wall];
+
+			FreeVector ray(current.position, target);
+			FreeVector segment(wall.a, wall.b);
+
+			double divider = ray.dx * segment.dy - ray.dy * segment.dx;
+
+			if (divider == 0)
+				return 0;
+
+			FreeVector toWall(current.position, wall.a);
+
+			double t = (toWall.dx * segment.dy - toWall.dy * segment.dx) / divider;
+			double s = (toWall.dx * ray.dy - toWall.dy * ray.dx) / divider;
+
+			if (t <= 0 || t >= 1 || s < 0 || s > 1)
+				return 0;
+
+			Point reflectionPoint = wall.a + segment * s + wall.normalVector * offset;
+
+			depth += absorption(tree, first, last, reflectionPoint, target);
+
+			if (depth > budget)
+				return 0;
+
+			target = reflectionPoint;
+			first = current.incomingBegin;
+			last = current.incomingEnd;
+		}
+
+		depth += absorption(tree, first, last, images[0].position, target) + tree.sourceAbsorption * FreeVector(images[0].position, target).d();
+
+		return depth > budget ? 0 : coefficient * std::exp(-depth);
+	}
+
+	// Rows are only visited where they cross the half-planes and the range of the image.
+	void evaluateRows(const ImageTree& tree, SignalMap& signalMap, int firstRow, int lastRow) const
+	{
+		double minimumCoefficient = getMinimumCoefficient().get<PowerCoefficient::Unit::coefficient>();
+		double scale = getScale();
+
+		Point origin = signalMap.getPosition(DiscretePoint(0, 0)).get<Distance::Unit::m>();
+		double step = signalMap.precision.get<Distance::Unit::m>();
+		int width = signalMap.resolution.width;
+
+		std::vector<double> powers((size_t)width * (lastRow - firstRow));
+
+		for (int index = 0; index < (int)tree.images.size(); index++)
+		{
+			const Image& image = tree.images[index];
+
+			for (int y = firstRow; y < lastRow; y++)
+			{
+				double positionY = origin.y + step * y;
+				double dy = positionY - image.position.y;
+
+				if (dy * dy > image.range)
+					continue;
+
+				double halfWidth = std::sqrt(image.range - dy * dy);
+				double begin = image.position.x - halfWidth;
+				double end = image.position.x + halfWidth;
+
+				for (int i = 0; i < image.halfPlanesCount && begin <= end; i++)
+				{
+					const HalfPlane& plane = image.halfPlanes[i];
+					double bound = plane.origin.x - (positionY - plane.origin.y) * plane.normalVector.dy / plane.normalVector.dx;
+
+					if (plane.normalVector.dx > 0)
+						begin = std::max(begin, bound);
+					else if (plane.normalVector.dx < 0)
+						end = std::min(end, bound);
+					else if (plane.value(Point(image.position.x, positionY)) < 0)
+						end = begin - 1;
+				}
+
+				if (begin > end)
+					continue;
+
+				int firstColumn = std::max(0, (int)std::floor((begin - origin.x) / step));
+				int lastColumn = std::min(width - 1, (int)std::ceil((end - origin.x) / step));
+
+				for (int x = firstColumn; x <= lastColumn; x++)
+				{
+					Point receiver(origin.x + step * x, positionY);
+
+					if (!image.covers(receiver))
+						continue;
+
+					powers[(size_t)(y - firstRow) * width + x] += evaluate(tree, index, receiver, scale, minimumCoefficient);
+				}
+			}
+		}
+
+		for (int y = firstRow; y < lastRow; y++)
+			for (int x = 0; x < width; x++)
+				signalMap.getElement(DiscretePoint(x, y)) = PowerCoefficient(powers[(size_t)(y - firstRow) * width + x]);
+	}
+
+	static Point getSource(Position transmitterPosition)
+	{
+		Point p = transmitterPosition.get<Distance::Unit::m>();
+		p.x += 0.0001;
+		p.y += 0.0002;
+
+		return p;
+	}
+
+	void simulate(Position transmitterPosition, SignalMap& signalMap, ThreadPoolPtr threadPool) const
+	{
+		ImageTree tree = buildImages(getSource(transmitterPosition));
+
+		int height = signalMap.resolution.height;
+		int tasks = (height + rowsPerTask - 1) / rowsPerTask;
+
+		parallelFor(threadPool, tasks, [&](int task) {
+			evaluateRows(tree, signalMap, task * rowsPerTask, std::min(height, (task + 1) * rowsPerTask));
+		});
+	}
+
+public:
+	ImageSourceSignalSimulation(SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition, Frequency frequency, ImageSourceSignalSimulationParameters simulationParameters) :
+		frequency(frequency),
+		simulationParameters(simulationParameters),
+		simulationSpaceDefinition(simulationSpaceDefinition)
+	{
+		for (const auto& obstacle : simulationSpaceDefinition->obstacles)
+		{
+			obstacle->boundary([&](Position a, Position b) {
+				Wall wall;
+				wall.a = a.get<Distance::Unit::m>();
+				wall.b = b.get<Distance::Unit::m>();
+
+				if (FreeVector(wall.a, wall.b).d() <= offset)
+					return;
+
+				wall.normalVector = Line(wall.a, wall.b).normalVector();
+
+				Point middle((wall.a.x + wall.b.x) / 2, (wall.a.y + wall.b.y) / 2);
+				Point probe = middle + wall.normalVector * (-1e-4);
+
+				if (!obstacle->inside(Position::in<Distance::Unit::m>(probe)))
+				{
+					wall.normalVector = -wall.normalVector;
+					probe = middle + wall.normalVector * (-1e-4);
+
+					if (!obstacle->inside(Position::in<Distance::Unit::m>(probe)))
+						return;
+				}
+
+				wall.reflection = obstacle->reflection(Position::in<Distance::Unit::m>(probe), frequency).get<PowerCoefficient::Unit::coefficient>();
+				wall.absorption = getAbsorption(*obstacle, probe);
+
+				walls.push_back(wall);
+			});
+		}
+	}
+
+	virtual SignalMapPtr simulate(Position transmitterPosition) const
+	{
+		auto signalMap = std::make_shared<SignalMap>(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision);
+		simulate(transmitterPosition, *signalMap, simulationParameters.threadPool);
+
+		return signalMap;
+	}
+
+	// Receivers are evaluated at their exact positions against every image.
+	virtual std::vector<PowerCoefficient> query(Position transmitterPosition, const std::vector<Position>& receiverPositions) const
+	{
+		ImageTree tree = buildImages(getSource(transmitterPosition));
+
+		double minimumCoefficient = getMinimumCoefficient().get<PowerCoefficient::Unit::coefficient>();
+		double scale = getScale();
+
+		std::vector<PowerCoefficient> powerCoefficients;
+		powerCoefficients.reserve(receiverPositions.size());
+
+		for (const auto& receiverPosition : receiverPositions)
+		{
+			Point receiver = receiverPosition.get<Distance::Unit::m>();
+			double power = 0;
+
+			for (int index = 0; index < (int)tree.images.size(); index++)
+				if (tree.images[index].covers(receiver))
+					power += evaluate(tree, index, receiver, scale, minimumCoefficient);
+
+			powerCoefficients.push_back(PowerCoefficient(power));
+		}
+
+		return powerCoefficients;
+	}
+
+	// Every transmitter is evaluated by a single task, so the thread pool of the parameters is not used here.
+	virtual void simulateBatch(const std::vector<Position>& transmitterPositions, ThreadPoolPtr threadPool, SignalMapCallback callback) const
+	{
+		runBatch<SignalMap>(
+			transmitterPositions,
+			threadPool,
+			[this] { return std::unique_ptr<SignalMap>(new SignalMap(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision)); },
+			[this, &callback](int index, Position transmitterPosition, SignalMap& signalMap) {
+				simulate(transmitterPosition, signalMap, nullptr);
+
+				callback(index, signalMap);
+			}
+		);
+	}
+};
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef NOGDI
+#define NOGDI
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Private (copy-on-write) mapping of a whole file. Writes through the mapping never reach the disk.
+class MappedFile
+{
+private:
+	void* data = nullptr;
+	size_t size = 0;
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+
+	MappedFile()
+	{ }
+
+public:
+	static std::shared_ptr<MappedFile> open(const std::string& path)
+	{
+		std::shared_ptr<MappedFile> mappedFile(new MappedFile());
+
+#ifdef _WIN32
+		mappedFile->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (mappedFile->file == INVALID_HANDLE_VALUE)
+			return nullptr;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(mappedFile->file, &fileSize) || fileSize.QuadPart == 0)
+			return nullptr;
+
+		mappedFile->mapping = CreateFileMappingA(mappedFile->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		if (mappedFile->mapping == NULL)
+			return nullptr;
+
+		mappedFile->data = MapViewOfFile(mappedFile->mapping, FILE_MAP_COPY, 0, 0, 0);
+		if (mappedFile->data == NULL)
+			return nullptr;
+
+		mappedFile->size = (size_t)fileSize.QuadPart;
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return nullptr;
+
+		struct stat fileStat;
+		if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+		{
+			close(file);
+			return nullptr;
+		}
+
+		void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		close(file);
+
+		if (data == MAP_FAILED)
+			return nullptr;
+
+		mappedFile->data = data;
+		mappedFile->size = (size_t)fileStat.st_size;
+#endif
+
+		return mappedFile;
+	}
+
+	~MappedFile()
+	{
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+#else
+		if (data)
+			munmap(data, size);
+#endif
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	void* getData() const { return data; }
+	size_t getSize() const { return size; }
+};
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include "UniformFiniteElementsSpace.hpp"
 
 #include <memory>
+#include <array>
+#include <functional>
 
 struct ObstacleDistortion
 {
@@ -21,7 +23,14 @@ struct ObstacleDistortion
 		coefficient(coefficient)
 	{ }
 
+	bool affects() const { return coefficient.get<PowerCoefficient::Unit::coefficient>() != 0; }
+
 	ObstacleDistortion operator+(const ObstacleDistortion& second) const {
+		if (!second.affects())
+			return *this;
+		if (!affects())
+			return second;
+
 		return ObstacleDistortion(
 			(normalVector * coefficient.get<PowerCoefficient::Unit::coefficient>() + second.normalVector * second.coefficient.get<PowerCoefficient::Unit::coefficient>()).normalized(),
 			std::max(coefficient, second.coefficient)
@@ -35,7 +44,23 @@ public:
 	virtual bool inside(Position position) const = 0;
 	virtual bool inSight(Position begin, Position end) const = 0;
 	virtual AbsorptionCoefficient absorption(Position begin, Position end, Frequency frequency) const = 0;
+	// Absorption at several frequencies at once, finding the crossings of the segment only once.
+	virtual void absorption(Position begin, Position end, const Frequency* frequencies, AbsorptionCoefficient* absorptions, size_t count) const = 0;
 	virtual ObstacleDistortion distortion(Position begin, Position end, Frequency frequency) const = 0;
+	// Reflection of the material at a position inside of the obstacle.
+	virtual PowerCoefficient reflection(Position position, Frequency frequency) const = 0;
+	virtual Surface getBounds() const = 0;
+	virtual void rasterize(Distance y, Distance step, int firstRow, int lastRow, std::function<void(int, Distance, Distance)>&& callback) const = 0;
+	virtual void boundary(std::function<void(Position, Position)>&& callback) const = 0;
+	virtual void fingerprint(Fingerprint& fingerprint, Frequency frequency) const = 0;
+
+	template<size_t Bands>
+	std::array<AbsorptionCoefficient, Bands> absorption(Position begin, Position end, const std::array<Frequency, Bands>& frequencies) const
+	{
+		std::array<AbsorptionCoefficient, Bands> absorptions;
+		absorption(begin, end, frequencies.data(), absorptions.data(), Bands);
+		return absorptions;
+	}
 };
 using ObstaclePtr = std::shared_ptr<const Obstacle>;
 
@@ -55,6 +80,40 @@ public:
 		return shape->contains(position.get<U>());
 	}
 
+	virtual PowerCoefficient reflection(Position position, Frequency frequency) const
+	{
+		return material->reflection(frequency);
+	}
+
+	virtual Surface getBounds() const
+	{
+		return Surface::in<U>(shape->getBounds());
+	}
+
+	virtual void rasterize(Distance y, Distance step, int firstRow, int lastRow, std::function<void(int, Distance, Distance)>&& callback) const
+	{
+		shape->rasterize(y.get<U>(), step.get<U>(), firstRow, lastRow, [&callback](int row, const Spans& spans) {
+			for (const auto& span : spans)
+				callback(row, Distance::in<U>(span.begin), Distance::in<U>(span.end));
+		});
+	}
+
+	virtual void boundary(std::function<void(Position, Position)>&& callback) const
+	{
+		shape->edges([&callback](const Line& line) {
+			callback(Position::in<U>(line.a), Position::in<U>(line.b));
+		});
+	}
+
+	virtual void fingerprint(Fingerprint& fingerprint, Frequency frequency) const
+	{
+		fingerprint << (int)U;
+		shape->fingerprint(fingerprint);
+		fingerprint
+			<< material->reflection(frequency).get<PowerCoefficient::Unit::coefficient>()
+			<< material->absorption(frequency).get<AbsorptionCoefficient::Unit::alpha>(Distance::in<Distance::Unit::m>(1));
+	}
+
 	virtual bool inSight(Position begin, Position end) const
 	{
 		if (shape->contains(begin.get<U>()))
@@ -77,30 +136,15 @@ public:
 
 	virtual AbsorptionCoefficient absorption(Position begin, Position end, Frequency frequency) const
 	{
-		AbsorptionCoefficient coefficient;
-		AbsorptionCoefficient materialCoefficient = material->absorption(frequency);
-
-		if (shape->contains(begin.get<U>()))
-			coefficient = materialCoefficient;
-
-		double distance = begin.distanceTo(end).get<U>();
-
-		Vector vector(
-			begin.get<U>(),
-			end.get<U>()
-		);
+		return material->absorption(frequency) * materialFraction(begin, end);
+	}
 
-		shape->intersections(vector, [&coefficient, &vector, &materialCoefficient, distance](const Intersection& intersection) {
-			if (intersection.inRange && intersection.distance > 0)
-			{
-				if (intersection.inRange && intersection.normalVector * vector.freeVector < 0)
-					coefficient = coefficient + materialCoefficient * (1 - intersection.distance / distance);
-				else
-					coefficient = coefficient - materialCoefficient * (1 - intersection.distance / distance);
-			}
-		});
+	virtual void absorption(Position begin, Position end, const Frequency* frequencies, AbsorptionCoefficient* absorptions, size_t count) const
+	{
+		double fraction = materialFraction(begin, end);
 
-		return coefficient.normalized();
+		for (size_t i = 0; i < count; i++)
+			absorptions[i] = material->absorption(frequencies[i]) * fraction;
 	}
 
 	virtual ObstacleDistortion distortion(Position begin, Position end, Frequency frequency) const
@@ -120,4 +164,33 @@ public:
 
 		return distortion;
 	}
+
+private:
+	// Part of the segment that runs inside of the shape.
+	double materialFraction(Position begin, Position end) const
+	{
+		double fraction = 0;
+
+		if (shape->contains(begin.get<U>()))
+			fraction = 1;
+
+		double distance = begin.distanceTo(end).get<U>();
+
+		Vector vector(
+			begin.get<U>(),
+			end.get<U>()
+		);
+
+		shape->intersections(vector, [&fraction, &vector, distance](const Intersection& intersection) {
+			if (intersection.inRange && intersection.distance > 0)
+			{
+				if (intersection.normalVector * vector.freeVector < 0)
+					fraction += 1 - intersection.distance / distance;
+				else
+					fraction -= 1 - intersection.distance / distance;
+			}
+		});
+
+		return std::max(0., fraction);
+	}
 };
\ No newline at end of file
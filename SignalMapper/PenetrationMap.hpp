@@ -0,0 +1,257 @@
+#pragma once
+
+#include "SignalSimulation.hpp"
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+enum class PenetrationMethod
+{
+	// Every transmitter-cell line is intersected with the obstacles.
+	exact,
+	// The absorption is accumulated along a fan of rays cast once from the transmitter through an AbsorptionMap;
+	// every cell takes the value of the ray that passes closest to it, which is never more than about half a cell away.
+	sweep
+};
+
+template<size_t Bands>
+struct Penetration
+{
+	// Absorption accumulated along the line (alpha times metres) for every band.
+	std::array<double, Bands> depth;
+	// Distance in cells between the cell and the ray the depth was taken from.
+	double offset;
+};
+
+// Absorption accumulated along the line from a transmitter to every cell, filled in by AbsorptionMap::sweep.
+template<size_t Bands = 1>
+class PenetrationMap : public SimulationUniformFiniteElementsSpace<Penetration<Bands>>
+{
+public:
+	PenetrationMap(Surface surface, Distance precision) :
+		SimulationUniformFiniteElementsSpace<Penetration<Bands>>(surface, precision)
+	{ }
+
+	LogPowerCoefficient getPowerCoefficient(const DiscretePoint& point, size_t band = 0) const
+	{
+		return LogPowerCoefficient(-this->getElement(point).depth[band] * 10 / std::log(10.));
+	}
+};
+
+// Absorption of all obstacles rasterized into the simulation grid, built once per engine. A cell holds the mean absorption
+// along its horizontal and vertical midlines, so cells that are only partly covered by a wall get a proportional share.
+template<size_t Bands = 1>
+class AbsorptionMap : protected SimulationUniformFiniteElementsSpace<std::array<AbsorptionCoefficient, Bands>>
+{
+public:
+	AbsorptionMap(const SignalSimulationSpaceDefinition& simulationSpaceDefinition, const std::array<Frequency, Bands>& frequencies) :
+		SimulationUniformFiniteElementsSpace<std::array<AbsorptionCoefficient, Bands>>(simulationSpaceDefinition.spaceSize, simulationSpaceDefinition.precision)
+	{
+		std::vector<bool> marked(this->resolution.width * this->resolution.height, false);
+		std::vector<DiscretePoint> touched;
+
+		auto mark = [&](const DiscretePoint& point) {
+			if (!this->inRange(point) || marked[point.y * this->resolution.width + point.x])
+				return;
+
+			marked[point.y * this->resolution.width + point.x] = true;
+			touched.push_back(point);
+		};
+
+		Distance half = this->precision * 0.5;
+
+		for (const auto& obstacle : simulationSpaceDefinition.obstacles)
+		{
+			this->forEachElementInside(*obstacle, mark);
+
+			obstacle->boundary([&](Position begin, Position end) {
+				int steps = (int)std::ceil(begin.distanceTo(end) / this->precision * 2) + 1;
+
+				for (int step = 0; step <= steps; step++)
+				{
+					double t = (double)step / steps;
+					DiscretePoint center = this->getDiscretePoint(Position(
+						begin.x() + (end.x() - begin.x()) * t + half,
+						begin.y() + (end.y() - begin.y()) * t + half
+					));
+
+					for (int dx = -1; dx <= 1; dx++)
+						for (int dy = -1; dy <= 1; dy++)
+							mark(DiscretePoint(center.x + dx, center.y + dy));
+				}
+			});
+
+			for (const auto& point : touched)
+			{
+				Position position = this->getPosition(point);
+				Position left(position.x() - half, position.y());
+				Position right(position.x() + half, position.y());
+				Position bottom(position.x(), position.y() - half);
+				Position top(position.x(), position.y() + half);
+
+				auto& element = this->getElement(point);
+
+				for (size_t band = 0; band < Bands; band++)
+				{
+					AbsorptionCoefficient horizontal = obstacle->absorption(left, right, frequencies[band]);
+					AbsorptionCoefficient vertical = obstacle->absorption(bottom, top, frequencies[band]);
+
+					element[band] = element[band] + AbsorptionCoefficient(
+						(horizontal.get<AbsorptionCoefficient::Unit::alpha>(this->precision) + vertical.get<AbsorptionCoefficient::Unit::alpha>(this->precision)) /
+						2 / this->precision.template get<Distance::Unit::m>());
+				}
+
+				marked[point.y * this->resolution.width + point.x] = false;
+			}
+
+			touched.clear();
+		}
+	}
+
+	const AbsorptionCoefficient& getAbsorption(const DiscretePoint& point, size_t band = 0) const
+	{
+		return this->getElement(point)[band];
+	}
+
+	// Casts enough rays that neighbouring ones are less than a cell apart at the far corner of the grid, so every cell is crossed
+	// by at least one of them. The cells are centered on the sample points of the signal maps, so a ray walks the grid with the
+	// Amanatides-Woo traversal and every cell takes the depth at its projection onto the nearest ray.
+	void sweep(Position transmitterPosition, PenetrationMap<Bands>& penetrationMap) const
+	{
+		int width = this->resolution.width;
+		int height = this->resolution.height;
+
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				penetrationMap.getElement(DiscretePoint(x, y)).offset = std::numeric_limits<double>::infinity();
+
+		Point origin = this->getPosition(DiscretePoint(0, 0)).template get<Distance::Unit::m>();
+		Point transmitter = transmitterPosition.get<Distance::Unit::m>();
+		double unit = this->precision.template get<Distance::Unit::m>();
+
+		Point source((transmitter.x - origin.x) / unit, (transmitter.y - origin.y) / unit);
+
+		double radius = 0;
+		for (double cornerX : { -0.5, width - 0.5 })
+			for (double cornerY : { -0.5, height - 0.5 })
+				radius = std::max(radius, std::hypot(cornerX - source.x, cornerY - source.y));
+
+		int raysCount = std::max(8, (int)std::ceil(2 * 3.141592653589793238463 * (radius + 1)));
+
+		for (int ray = 0; ray < raysCount; ray++)
+		{
+			double angle = 2 * 3.141592653589793238463 * ray / raysCount;
+			cast(source, FreeVector(std::cos(angle), std::sin(angle)), penetrationMap);
+		}
+
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				auto& penetration = penetrationMap.getElement(DiscretePoint(x, y));
+
+				if (penetration.offset == std::numeric_limits<double>::infinity())
+					penetration.depth.fill(0);
+			}
+		}
+	}
+
+private:
+	void cast(Point source, FreeVector direction, PenetrationMap<Bands>& penetrationMap) const
+	{
+		int width = this->resolution.width;
+		int height = this->resolution.height;
+
+		// Cells span [i - 0.5, i + 0.5), so the traversal runs on coordinates shifted by half a cell.
+		Point shifted(source.x + 0.5, source.y + 0.5);
+
+		double entry = 0;
+		double leave = std::numeric_limits<double>::infinity();
+
+		if (!clip(shifted.x, direction.dx, width, entry, leave) || !clip(shifted.y, direction.dy, height, entry, leave))
+			return;
+
+		double startX = shifted.x + direction.dx * entry;
+		double startY = shifted.y + direction.dy * entry;
+
+		int cellX = std::min(width - 1, std::max(0, (int)std::floor(startX)));
+		int cellY = std::min(height - 1, std::max(0, (int)std::floor(startY)));
+
+		int stepX = direction.dx > 0 ? 1 : -1;
+		int stepY = direction.dy > 0 ? 1 : -1;
+
+		double deltaX = direction.dx != 0 ? 1 / std::abs(direction.dx) : std::numeric_limits<double>::infinity();
+		double deltaY = direction.dy != 0 ? 1 / std::abs(direction.dy) : std::numeric_limits<double>::infinity();
+
+		double nextX = direction.dx != 0 ? ((direction.dx > 0 ? cellX + 1 : cellX) - shifted.x) / direction.dx : std::numeric_limits<double>::infinity();
+		double nextY = direction.dy != 0 ? ((direction.dy > 0 ? cellY + 1 : cellY) - shifted.y) / direction.dy : std::numeric_limits<double>::infinity();
+
+		std::array<double, Bands> depth;
+		depth.fill(0);
+
+		while (cellX >= 0 && cellX < width && cellY >= 0 && cellY < height)
+		{
+			double exit = std::min(nextX, nextY);
+
+			DiscretePoint cell(cellX, cellY);
+			const std::array<AbsorptionCoefficient, Bands>& absorption = this->getElement(cell);
+
+			double relativeX = cellX - source.x;
+			double relativeY = cellY - source.y;
+
+			double offset = std::abs(relativeX * direction.dy - relativeY * direction.dx);
+			auto& penetration = penetrationMap.getElement(cell);
+
+			if (offset < penetration.offset)
+			{
+				double projection = std::min(exit, std::max(entry, relativeX * direction.dx + relativeY * direction.dy));
+
+				penetration.offset = offset;
+				for (size_t band = 0; band < Bands; band++)
+					penetration.depth[band] = depth[band] + perCell(absorption[band]) * (projection - entry);
+			}
+
+			for (size_t band = 0; band < Bands; band++)
+				depth[band] += perCell(absorption[band]) * (exit - entry);
+
+			entry = exit;
+
+			if (nextX < nextY)
+			{
+				cellX += stepX;
+				nextX += deltaX;
+			}
+			else
+			{
+				cellY += stepY;
+				nextY += deltaY;
+			}
+		}
+	}
+
+	double perCell(const AbsorptionCoefficient& absorption) const
+	{
+		return absorption.get<AbsorptionCoefficient::Unit::alpha>(this->precision);
+	}
+
+	// Narrows [entry, leave] to the part of the ray within [0, size) along one axis.
+	static bool clip(double origin, double direction, int size, double& entry, double& leave)
+	{
+		if (direction == 0)
+			return origin >= 0 && origin < size;
+
+		double t1 = (0 - origin) / direction;
+		double t2 = (size - origin) / direction;
+
+		if (t1 > t2)
+			std::swap(t1, t2);
+
+		entry = std::max(entry, t1);
+		leave = std::min(leave, t2);
+
+		return entry <= leave;
+	}
+};
\ No newline at end of file
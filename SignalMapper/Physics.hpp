@@ -263,7 +263,7 @@ public:
 	template<>
 	double get<Unit::alpha>(Distance thickness) const { return alpha * thickness.get<Distance::Unit::m>(); }
 	template<>
-	double get<Unit::dB>(Distance thickness) const { return 10 * std::log10(get<Unit::coefficient>(thickness)); }
+	double get<Unit::dB>(Distance thickness) const { return -get<Unit::alpha>(thickness) * 10 / std::log(10.0); }
 	template<>
 	double get<Unit::coefficient>(Distance thickness) const { return std::exp(-get<Unit::alpha>(thickness)); }
 
@@ -356,6 +356,79 @@ public:
 	}
 };
 
+// Power coefficient kept in dB, so that chaining gains and losses is an addition.
+// A zero coefficient is represented by -infinity dB.
+struct LogPowerCoefficient {
+private:
+	double dB;
+
+public:
+	enum class Unit
+	{
+		coefficient,
+		dB
+	};
+
+	LogPowerCoefficient() :
+		dB(-std::numeric_limits<double>::infinity())
+	{ }
+
+	explicit LogPowerCoefficient(double dB) :
+		dB(dB)
+	{ }
+
+	LogPowerCoefficient(const PowerCoefficient& coefficient) :
+		dB(coefficient.get<PowerCoefficient::Unit::dB>())
+	{ }
+
+	template<Unit U>
+	static LogPowerCoefficient in(double value)
+	{
+		LogPowerCoefficient c;
+		c.set<U>(value);
+		return c;
+	}
+
+	static LogPowerCoefficient of(const AbsorptionCoefficient& absorption, Distance thickness)
+	{
+		return LogPowerCoefficient(absorption.get<AbsorptionCoefficient::Unit::dB>(thickness));
+	}
+
+	template<Unit U>
+	double get() const = 0;
+	template<>
+	double get<Unit::coefficient>() const { return std::pow(10.0, dB / 10.0); };
+	template<>
+	double get<Unit::dB>() const { return dB; };
+
+	template<Unit U>
+	void set(double value) = 0;
+	template<>
+	void set<Unit::coefficient>(double value) { dB = 10 * std::log10(value); }
+	template<>
+	void set<Unit::dB>(double value) { dB = value; }
+
+	operator PowerCoefficient() const
+	{
+		return PowerCoefficient(get<Unit::coefficient>());
+	}
+
+	bool operator<(const LogPowerCoefficient& second) const
+	{
+		return dB < second.dB;
+	}
+
+	friend LogPowerCoefficient operator*(const LogPowerCoefficient& a, const LogPowerCoefficient& b)
+	{
+		return LogPowerCoefficient(a.dB + b.dB);
+	}
+
+	friend LogPowerCoefficient operator/(const LogPowerCoefficient& a, const LogPowerCoefficient& b)
+	{
+		return LogPowerCoefficient(a.dB - b.dB);
+	}
+};
+
 struct AntenaGain {
 protected:
 	double coefficient;
@@ -0,0 +1,267 @@
+#pragma once
+
+#include "Physics.hpp"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+// Binary raster file written top to bottom from the blocks of SignalMap::resampleInBlocks. Pixels are encoded into a buffer
+// that goes to the file in single large writes, so exporting a big map costs little more than the disk bandwidth.
+class RasterWriter
+{
+private:
+	static const size_t flushSize = 4 << 20;
+
+	std::ofstream file;
+	std::vector<char> buffer;
+	int writtenRows = 0;
+
+protected:
+	int width;
+	int height;
+
+	RasterWriter(const std::string& path, int width, int height) :
+		file(path, std::ios::out | std::ios::binary | std::ios::trunc),
+		width(width),
+		height(height)
+	{
+		buffer.reserve(flushSize + (size_t)width * sizeof(float));
+	}
+
+	char* allocate(size_t size)
+	{
+		buffer.resize(buffer.size() + size);
+		return buffer.data() + buffer.size() - size;
+	}
+
+	template<typename T>
+	void append(T value)
+	{
+		std::memcpy(allocate(sizeof(T)), &value, sizeof(T));
+	}
+
+	// Appends one row; walls is 1 for pixels inside of obstacles and may be null.
+	virtual void encode(const float* signals, const uint8_t* walls) = 0;
+
+public:
+	virtual ~RasterWriter()
+	{
+		flush();
+	}
+
+	RasterWriter(const RasterWriter&) = delete;
+	RasterWriter& operator=(const RasterWriter&) = delete;
+
+	// Appends rows rows of width pixels each, walls may be null.
+	void write(const float* signals, const uint8_t* walls, int rows)
+	{
+		for (int row = 0; row < rows; row++)
+		{
+			encode(signals + (size_t)row * width, walls ? walls + (size_t)row * width : nullptr);
+
+			if (buffer.size() >= flushSize)
+				flush();
+		}
+
+		writtenRows += rows;
+	}
+
+	void flush()
+	{
+		if (!buffer.empty())
+			file.write(buffer.data(), buffer.size());
+
+		buffer.clear();
+		file.flush();
+	}
+
+	// True if every row has been written and reached the file.
+	bool close()
+	{
+		flush();
+		file.close();
+
+		return !file.fail() && writtenRows == height;
+	}
+};
+using RasterWriterPtr = std::shared_ptr<RasterWriter>;
+
+// Binary grayscale PGM (P5): the power is mapped linearly from minimum (black) to maximum (white).
+class PGMRasterWriter : public RasterWriter
+{
+private:
+	float minimum;
+	float maximum;
+	uint8_t obstacleLevel;
+
+	uint8_t level(float signal) const
+	{
+		float scaled = (signal - minimum) / (maximum - minimum);
+
+		return scaled > 0 ? (uint8_t)(std::min(scaled, 1.f) * 255) : 0;
+	}
+
+protected:
+	virtual void encode(const float* signals, const uint8_t* walls)
+	{
+		char* out = allocate(width);
+
+		for (int column = 0; column < width; column++)
+			out[column] = walls && walls[column] ? obstacleLevel : level(signals[column]);
+	}
+
+public:
+	PGMRasterWriter(const std::string& path, int width, int height, Power minimum, Power maximum, uint8_t obstacleLevel = 50) :
+		RasterWriter(path, width, height),
+		minimum((float)minimum.get<Power::Unit::dBm>()),
+		maximum((float)maximum.get<Power::Unit::dBm>()),
+		obstacleLevel(obstacleLevel)
+	{
+		std::string header = "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+		std::memcpy(allocate(header.size()), header.data(), header.size());
+	}
+};
+
+// Raw float32 power in dBm (-infinity where there is no signal) after a 64 byte header with the size of the raster
+// and the area it covers in metres. Obstacles are not marked.
+class FloatRasterWriter : public RasterWriter
+{
+public:
+	struct Header
+	{
+		char magic[8];
+		int32_t width;
+		int32_t height;
+		double minX;
+		double minY;
+		double maxX;
+		double maxY;
+		char reserved[16];
+	};
+
+	static_assert(sizeof(Header) == 64, "Pixels of a raster file have to stay aligned");
+
+	static const char* magic() { return "SIGRAST"; }
+
+protected:
+	virtual void encode(const float* signals, const uint8_t* walls)
+	{
+		std::memcpy(allocate((size_t)width * sizeof(float)), signals, (size_t)width * sizeof(float));
+	}
+
+public:
+	FloatRasterWriter(const std::string& path, int width, int height, const Rectangle& area) :
+		RasterWriter(path, width, height)
+	{
+		Header header = {};
+		std::memcpy(header.magic, magic(), sizeof(header.magic));
+		header.width = width;
+		header.height = height;
+		header.minX = area.minX();
+		header.minY = area.minY();
+		header.maxX = area.maxX();
+		header.maxY = area.maxY();
+
+		append(header);
+	}
+};
+
+// 8-bit indexed BMP stored top-down. Index 0 (black) is no signal or anything up to minimum, indices 1 - 254 run from blue
+// through green to red up to maximum, and index 255 (gray) marks obstacles.
+class PaletteRasterWriter : public RasterWriter
+{
+private:
+	float minimum;
+	float maximum;
+	int padding;
+
+	static void color(int index, uint8_t& red, uint8_t& green, uint8_t& blue)
+	{
+		if (index == 0)
+		{
+			red = green = blue = 0;
+			return;
+		}
+
+		if (index == 255)
+		{
+			red = green = blue = 128;
+			return;
+		}
+
+		double t = (index - 1) / 253.;
+
+		auto channel = [t](double center) {
+			return (uint8_t)(255 * std::max(0., std::min(1., 1.5 - std::abs(4 * t - center))));
+		};
+
+		red = channel(3);
+		green = channel(2);
+		blue = channel(1);
+	}
+
+protected:
+	virtual void encode(const float* signals, const uint8_t* walls)
+	{
+		char* out = allocate(width + padding);
+
+		for (int column = 0; column < width; column++)
+		{
+			if (walls && walls[column])
+				out[column] = (char)255;
+			else
+			{
+				float scaled = (signals[column] - minimum) / (maximum - minimum);
+				out[column] = scaled > 0 ? (char)(uint8_t)(1 + std::min(scaled, 1.f) * 253) : 0;
+			}
+		}
+
+		std::fill(out + width, out + width + padding, 0);
+	}
+
+public:
+	PaletteRasterWriter(const std::string& path, int width, int height, Power minimum, Power maximum) :
+		RasterWriter(path, width, height),
+		minimum((float)minimum.get<Power::Unit::dBm>()),
+		maximum((float)maximum.get<Power::Unit::dBm>()),
+		padding((4 - width % 4) % 4)
+	{
+		uint32_t pixelsOffset = 14 + 40 + 256 * 4;
+		uint32_t pixelsSize = (uint32_t)((size_t)(width + padding) * height);
+
+		append('B');
+		append('M');
+		append<uint32_t>(pixelsOffset + pixelsSize);
+		append<uint32_t>(0);
+		append<uint32_t>(pixelsOffset);
+
+		append<uint32_t>(40);
+		append<int32_t>(width);
+		append<int32_t>(-height);
+		append<uint16_t>(1);
+		append<uint16_t>(8);
+		append<uint32_t>(0);
+		append<uint32_t>(pixelsSize);
+		append<int32_t>(2835);
+		append<int32_t>(2835);
+		append<uint32_t>(256);
+		append<uint32_t>(0);
+
+		for (int index = 0; index < 256; index++)
+		{
+			uint8_t red, green, blue;
+			color(index, red, green, blue);
+
+			append(blue);
+			append(green);
+			append(red);
+			append<uint8_t>(0);
+		}
+	}
+};
\ No newline at end of file
@@ -1,9 +1,18 @@
 #pragma once
 
 #include "SignalSimulation.hpp"
+#include "DistortionSpace.hpp"
+#include "ThreadPool.hpp"
 
 #include <vector>
 #include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <type_traits>
 
 struct RaycastingSignalSimulationParameters {
 	int raysCount;
@@ -11,56 +20,146 @@ struct RaycastingSignalSimulationParameters {
 	Transmitter bestTransmitter;
 	Receiver bestReceiver;
 	Power minimumPower;
+	ThreadPoolPtr threadPool;
+	// With adaptive rays, raysCount is only the number of initial ray tubes; each of them is split in two
+	// whenever it gets wider than a cell, so neighbouring rays never leave a cell between them.
+	bool adaptiveRays;
+	// With dominance pruning a ray is dropped, together with its future reflections, once both its power and the power it carries
+	// (what is left after its reflections and absorption) are at least dominanceMargin dB below those of the strongest ray
+	// already seen in its cell, in every band, going the same way up to the angular resolution of the ray: the spread of its tube
+	// with adaptive rays, the angle between two initial rays otherwise. That takes 8 bytes per cell and band, shared by all tasks.
+	bool dominancePruning;
+	double dominanceMargin;
 
 	RaycastingSignalSimulationParameters(
 		int raysCount,
 		int reflectionCount,
 		Transmitter bestTransmitter,
 		Receiver bestReceiver,
-		Power minimumPower
+		Power minimumPower,
+		ThreadPoolPtr threadPool = nullptr,
+		bool adaptiveRays = false,
+		bool dominancePruning = false,
+		double dominanceMargin = 3
 	) :
 		raysCount(raysCount),
 		reflectionCount(reflectionCount),
 		bestTransmitter(bestTransmitter),
 		bestReceiver(bestReceiver),
-		minimumPower(minimumPower)
+		minimumPower(minimumPower),
+		threadPool(threadPool),
+		adaptiveRays(adaptiveRays),
+		dominancePruning(dominancePruning),
+		dominanceMargin(dominanceMargin)
 	{ }
 };
 
-class RaycastingSignalSimulation : public SignalSimulation
+struct RaycastingSignalSimulationStatistics
 {
-private:
-	struct Distortion
-	{
-		AbsorptionCoefficient absorption;
-		ObstacleDistortion reflection;
-	};
+	uint64_t simulations;
+	// Rays traced, including the reflected and split ones.
+	uint64_t rays;
+	// Cells visited by all of the rays.
+	uint64_t steps;
+	// Rays stopped by dominance pruning. Only rays still above the minimum power in some band are ever pruned,
+	// the others stop on their own.
+	uint64_t prunedRays;
+	// Sum over the pruned rays of the margin by which the ray that dominated them was ahead, in hundredths of a dB
+	// (the smallest one over the bands and over the power and the carried power); divided by prunedRays it gives the mean.
+	uint64_t prunedMargin;
+};
 
+// Scalar is the storage type of the distortion space (double, float or QuantizedDecibels).
+// Bands is the number of frequencies that share every ray; each of them gets its own signal map.
+template<typename Scalar, size_t Bands = 1>
+class BasicRaycastingSignalSimulation : public SignalSimulation
+{
+private:
+	// Ray walked through the grid with the Amanatides-Woo traversal. The origin is in grid units
+	// (cells of the simulation space), so crossing a cell boundary is a single comparison.
 	struct Ray
 	{
+		Point origin;
+		FreeVector normalVector;
+
 		DiscretePoint position;
+		double entry;
 
-		Position source;
-		Distance distance;
-		Distance previousDistance;
+		int stepX, stepY;
+		double nextX, nextY;
+		double deltaX, deltaY;
 
-		FreeVector normalVector;
-		FreeVector offset;
+		Distance distance;
+		int reflections;
 
-		int reflections = 0;
+		// Angular width of the tube around the ray in radians, 0 for rays that are never split.
+		double spread;
 
-		PowerCoefficient powerCoefficient;
+		std::array<PowerCoefficient, Bands> powerCoefficients;
 
-		Ray(Position source, DiscretePoint position, FreeVector normalVector, int reflections) :
-			source(source),
-			position(position),
+		Ray(Point origin, DiscretePoint position, FreeVector normalVector, Distance distance, int reflections, double spread, const std::array<PowerCoefficient, Bands>& powerCoefficients) :
+			origin(origin),
 			normalVector(normalVector.normalized()),
+			position(position),
+			entry(0),
+			distance(distance),
 			reflections(reflections),
-			powerCoefficient(PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(1))
-		{ }
+			spread(spread),
+			powerCoefficients(powerCoefficients)
+		{
+			initialize(this->normalVector.dx, origin.x, position.x, stepX, nextX, deltaX);
+			initialize(this->normalVector.dy, origin.y, position.y, stepY, nextY, deltaY);
+		}
+
+		double exit() const
+		{
+			return std::min(nextX, nextY);
+		}
+
+		// Index of the base direction through which the ray leaves the current cell.
+		int exitDirection() const
+		{
+			if (nextX < nextY)
+				return stepX > 0 ? 0 : 1;
+			else
+				return stepY > 0 ? 2 : 3;
+		}
+
+		void advance()
+		{
+			entry = exit();
+
+			if (nextX < nextY)
+			{
+				position.x += stepX;
+				nextX += deltaX;
+			}
+			else
+			{
+				position.y += stepY;
+				nextY += deltaY;
+			}
+		}
+
+	private:
+		static void initialize(double direction, double origin, int cell, int& step, double& next, double& delta)
+		{
+			step = direction > 0 ? 1 : -1;
+
+			if (direction == 0)
+			{
+				next = std::numeric_limits<double>::infinity();
+				delta = std::numeric_limits<double>::infinity();
+			}
+			else
+			{
+				next = std::max(0., ((direction > 0 ? cell + 1 : cell) - origin) / direction);
+				delta = 1 / std::abs(direction);
+			}
+		}
 	};
 
-	const Frequency frequency;
+	const std::array<Frequency, Bands> frequencies;
 	const RaycastingSignalSimulationParameters simulationParameters;
 
 	const std::array<DiscreteDirection, 4> baseDirections{
@@ -72,79 +171,168 @@ private:
 		}
 	};
 
-	DiscreteDirection toBaseDirection(const FreeVector& vector) const
-	{
-		return DiscreteDirection(
-			std::abs(vector.dx) > std::abs(vector.dy) ? vector.dx > 0 ? 1 : -1 : 0,
-			std::abs(vector.dx) <= std::abs(vector.dy) ? vector.dy > 0 ? 1 : -1 : 0
-		);
-	}
+	DistortionSpace<4, Scalar, UniformFiniteElementsSpace, Bands> simulationSpace;
 
-	int toBaseDirectionIndex(const DiscreteDirection& direction) const
+	static const int raysPerTask = 16;
+
+	struct Counters
 	{
-		if (direction.x)
-			return direction.x > 0 ? 0 : 1;
-		else
-			return direction.y > 0 ? 2 : 3;
-	}
+		std::atomic<uint64_t> simulations{ 0 };
+		std::atomic<uint64_t> rays{ 0 };
+		std::atomic<uint64_t> steps{ 0 };
+		std::atomic<uint64_t> prunedRays{ 0 };
+		std::atomic<uint64_t> prunedMargin{ 0 };
+	};
 
-	SimulationUniformFiniteElementsSpace<std::array<Distortion, 4>> simulationSpace;
+	mutable Counters statistics;
 
-public:
-	RaycastingSignalSimulation(SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition, Frequency frequency, RaycastingSignalSimulationParameters simulationParameters) :
-		frequency(frequency),
-		simulationParameters(simulationParameters),
-		simulationSpace(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision)
+	// Chebyshev distance (in cells, capped) from every cell to the nearest distorted one. A ray that enters
+	// a cell with clearance k can take k steps without looking at the distortion space.
+	SimulationUniformFiniteElementsSpace<uint8_t> clearance;
+
+	void computeClearance()
 	{
-		for (const auto& obstacle : simulationSpaceDefinition->obstacles)
-		{
-			for (int x = 0; x < simulationSpace.resolution.width; x++)
-			{
-				for (int y = 0; y < simulationSpace.resolution.height; y++)
-				{
-					DiscretePoint firstDiscretePosition(x, y);
-					Position firstPosition = simulationSpace.getPosition(firstDiscretePosition);
+		const int maxClearance = std::numeric_limits<uint8_t>::max();
 
-					auto& element = simulationSpace.getElement(firstDiscretePosition);
+		int width = clearance.resolution.width;
+		int height = clearance.resolution.height;
 
-					for (int i = 0; i < baseDirections.size(); i++)
-					{
-						DiscretePoint secondDiscretePosition = firstDiscretePosition + baseDirections[i];
-						Position secondPosition = simulationSpace.getPosition(secondDiscretePosition);
+		auto at = [&](int x, int y) -> int {
+			if (x < 0 || x >= width || y < 0 || y >= height)
+				return maxClearance;
+
+			return clearance.getElement(DiscretePoint(x, y));
+		};
+
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				int value = simulationSpace.distorted(DiscretePoint(x, y)) ? 0 : maxClearance;
+				value = std::min(value, std::min(std::min(at(x - 1, y), at(x - 1, y - 1)), std::min(at(x, y - 1), at(x + 1, y - 1))) + 1);
 
-						auto& connection = element[i];
+				clearance.getElement(DiscretePoint(x, y)) = (uint8_t)value;
+			}
+		}
 
-						auto absorption = obstacle->absorption(firstPosition, secondPosition, frequency);
-						connection.absorption = connection.absorption + absorption;
+		for (int y = height - 1; y >= 0; y--)
+		{
+			for (int x = width - 1; x >= 0; x--)
+			{
+				int value = clearance.getElement(DiscretePoint(x, y));
+				value = std::min(value, std::min(std::min(at(x + 1, y), at(x + 1, y + 1)), std::min(at(x, y + 1), at(x - 1, y + 1))) + 1);
 
-						auto distortion = obstacle->distortion(firstPosition, secondPosition, frequency);
-						connection.reflection = connection.reflection + distortion;
-					}
-				}
+				clearance.getElement(DiscretePoint(x, y)) = (uint8_t)value;
 			}
 		}
 	}
 
-	virtual SignalMapPtr simulate(Position transmitterPosition) const
+	struct Scratch
 	{
-		auto signalMap = std::make_shared<SignalMap>(simulationSpace.surface, simulationSpace.precision);
-		auto minimumCoefficient =
+		std::array<std::unique_ptr<SignalMap>, Bands> signalMaps;
+		std::vector<Ray> rays;
+		std::vector<std::atomic<uint64_t>> dominance;
+
+		Scratch(Surface surface, Distance precision)
+		{
+			for (auto& signalMap : signalMaps)
+				signalMap.reset(new SignalMap(surface, precision));
+		}
+	};
+
+	PowerCoefficient getMinimumCoefficient() const
+	{
+		return
 			simulationParameters.minimumPower /
 			(simulationParameters.bestTransmitter.power *
 				simulationParameters.bestTransmitter.antenaGain *
 				simulationParameters.bestReceiver.antenaGain);
+	}
 
-		std::vector<Ray> rays;
+	// Strongest ray seen in a cell and band, packed in a single word so that concurrent tasks can share the table:
+	// the direction in 1/65536 of a turn, then its power and its carried power as floats cut to their top 24 bits
+	// (without the sign), which rounds them down, so the stored ray never looks stronger than it was. An empty slot is 0.
+	static uint64_t packDominance(uint16_t angle, double strength, double carried)
+	{
+		return angle | (uint64_t)truncate(strength) << 16 | (uint64_t)truncate(carried) << 40;
+	}
 
-		for (int i = 0; i < simulationParameters.raysCount; i++)
+	static uint32_t truncate(double value)
+	{
+		float single = (float)value;
+		uint32_t bits;
+		std::memcpy(&bits, &single, sizeof(bits));
+
+		return bits >> 7;
+	}
+
+	static double expand(uint64_t bits)
+	{
+		uint32_t single = (uint32_t)(bits & 0xffffff) << 7;
+		float value;
+		std::memcpy(&value, &single, sizeof(value));
+
+		return value;
+	}
+
+	static uint16_t getAngle(const FreeVector& normalVector)
+	{
+		double turns = std::atan2(normalVector.dy, normalVector.dx) / (std::atan(1.) * 8);
+
+		return (uint16_t)(int64_t)std::floor(turns * 65536);
+	}
+
+	// Strongest ray seen in every cell and band; empty when dominance pruning is off.
+	void resetDominance(std::vector<std::atomic<uint64_t>>& dominance) const
+	{
+		if (!simulationParameters.dominancePruning)
+			return;
+
+		size_t size = (size_t)simulationSpace.resolution.width * simulationSpace.resolution.height * Bands;
+
+		if (dominance.size() != size)
+			std::vector<std::atomic<uint64_t>>(size).swap(dominance);
+		else
+			for (auto& slot : dominance)
+				slot.store(0, std::memory_order_relaxed);
+	}
+
+	// A ray goes on as long as any of its bands is above the minimum, but only raises the maps of those that are,
+	// so every band ends up with the same map as a single band simulation of its frequency.
+	template<typename Map>
+	void castRays(Position transmitterPosition, int firstRay, int lastRay, PowerCoefficient minimumCoefficient, const std::array<Map*, Bands>& signalMaps, std::vector<Ray>& rays, std::vector<std::atomic<uint64_t>>& dominance) const
+	{
+		const Distance precision = simulationSpace.precision;
+		const int width = simulationSpace.resolution.width;
+		const double dominanceFactor = std::pow(10., simulationParameters.dominanceMargin / 10);
+
+		uint64_t tracedRays = 0;
+		uint64_t steps = 0;
+		uint64_t prunedRays = 0;
+		uint64_t prunedMargin = 0;
+
+		Point origin(
+			(transmitterPosition.x() - simulationSpace.surface.minX()) / precision,
+			(transmitterPosition.y() - simulationSpace.surface.minY()) / precision
+		);
+
+		std::array<PowerCoefficient, Bands> initialPowerCoefficients;
+		initialPowerCoefficients.fill(PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(1));
+
+		double spread = simulationParameters.adaptiveRays ? std::atan(1.) * 8 / simulationParameters.raysCount : 0;
+
+		for (int i = firstRay; i < lastRay; i++)
 		{
 			double alpha = 0.123 + std::atan(1.) * 8 * i / simulationParameters.raysCount;
 
 			Ray ray(
-				transmitterPosition,
+				origin,
 				simulationSpace.getDiscretePoint(transmitterPosition),
 				FreeVector(std::sin(alpha), std::cos(alpha)),
-				simulationParameters.reflectionCount
+				Distance(),
+				simulationParameters.reflectionCount,
+				spread,
+				initialPowerCoefficients
 			);
 
 			rays.push_back(ray);
@@ -155,54 +343,339 @@ public:
 			Ray ray = *rays.rbegin();
 			rays.pop_back();
 
-			if (!signalMap->inRange(ray.position))
-				continue;
+			// Rays are told apart by their direction, up to their own angular resolution, in 1/65536 of a turn.
+			uint16_t angle = dominance.empty() ? 0 : getAngle(ray.normalVector);
+			int tolerance = (int)(ray.spread > 0 ? 65536 * ray.spread / (std::atan(1.) * 8) : 65536. / simulationParameters.raysCount);
 
-			Distance distance = ray.distance + ray.source.distanceTo(signalMap->getPosition(ray.position));
-			PowerCoefficient strength = ray.powerCoefficient * std::pow(frequency / (distance * 4 * 3.141592653589793238463), 2);
+			tracedRays++;
 
-			if (strength < minimumCoefficient)
-				continue;
+			for (int freeSteps = 0; simulationSpace.inRange(ray.position); ray.advance())
+			{
+				// The width of the tube is measured along the whole unfolded path, in cells.
+				if (ray.spread * (ray.distance / precision + ray.entry) > 1)
+				{
+					split(ray, rays);
+					break;
+				}
 
-			auto& mapElement = signalMap->getElement(ray.position);
-			if (mapElement < strength)
-				mapElement = strength;
+				double exit = ray.exit();
 
-			auto& connections = simulationSpace.getElement(ray.position);
+				Distance distance = ray.distance + precision * ((ray.entry + exit) / 2);
+				bool reaching = false;
+				// Rays going the same way only meet after reflecting from the same wall, so they are compared in the cells of the walls.
+				bool dominated = !dominance.empty() && freeSteps == 0 && clearance.getElement(ray.position) == 0;
+				double margin = std::numeric_limits<double>::infinity();
 
-			FreeVector newOffset = ray.offset + ray.normalVector;
-			DiscreteDirection direction = toBaseDirection(newOffset);
+				std::atomic<uint64_t>* slots = dominated ? &dominance[(size_t)(ray.position.y * width + ray.position.x) * Bands] : nullptr;
 
-			auto& connection = connections[toBaseDirectionIndex(direction)];
+				steps++;
 
-			Distance distanceDiff = distance - ray.previousDistance;
+				for (size_t band = 0; band < Bands; band++)
+				{
+					double pathLoss = frequencies[band] / (distance * 4 * 3.141592653589793238463);
+					PowerCoefficient strength = ray.powerCoefficients[band] * (pathLoss * pathLoss);
 
-			if (ray.reflections > 0 && connection.reflection.coefficient.get<PowerCoefficient::Unit::coefficient>() != 0)
-			{
-				Ray reflectedRay = ray;
-				reflectedRay.reflections--;
-				reflectedRay.normalVector = ray.normalVector.reflectedBy(connection.reflection.normalVector).normalized();
-				reflectedRay.offset = reflectedRay.offset.reflectedBy(connection.reflection.normalVector);
-				reflectedRay.powerCoefficient = ray.powerCoefficient * connection.reflection.coefficient;
-				reflectedRay.distance = reflectedRay.distance + distance;
-				reflectedRay.previousDistance = Distance();
-				reflectedRay.source = signalMap->getPosition(reflectedRay.position);
-				rays.push_back(reflectedRay);
-			}
+					if (strength < minimumCoefficient)
+						continue;
 
-			if (connection.absorption.get<AbsorptionCoefficient::Unit::coefficient>(distanceDiff) != 1)
-			{
-				ray.powerCoefficient = ray.powerCoefficient * connection.absorption.get<AbsorptionCoefficient::Unit::coefficient>(distanceDiff);
+					signalMaps[band]->raise(ray.position, strength);
+					reaching = true;
+
+					// A ray that goes the same way from the same cell as a stronger one meets the same walls and cells after it;
+					// if it is weaker now and carries less power it can not get ahead further on either, as the ratio of their
+					// powers only moves monotonically from the one of their powers now to the one of the powers they carry.
+					if (slots)
+					{
+						double value = strength.get<PowerCoefficient::Unit::coefficient>();
+						double carried = ray.powerCoefficients[band].template get<PowerCoefficient::Unit::coefficient>();
+
+						auto& slot = slots[band];
+						uint64_t best = slot.load(std::memory_order_relaxed);
+
+						double bestValue = expand(best >> 16);
+						double bestCarried = expand(best >> 40);
+
+						if (std::abs((int16_t)(uint16_t)(angle - (uint16_t)best)) <= tolerance &&
+							value * dominanceFactor <= bestValue && carried * dominanceFactor <= bestCarried)
+						{
+							margin = std::min(margin, 10 * std::log10(std::min(bestValue / value, bestCarried / carried)));
+							continue;
+						}
+
+						dominated = false;
+
+						uint64_t packed = packDominance(angle, value, carried);
+
+						while (expand(packed >> 16) > expand(best >> 16) && !slot.compare_exchange_weak(best, packed, std::memory_order_relaxed))
+						{ }
+					}
+				}
+
+				if (!reaching)
+					break;
+
+				if (dominated)
+				{
+					prunedRays++;
+					prunedMargin += (uint64_t)(margin * 100);
+					break;
+				}
+
+				if (freeSteps == 0)
+					freeSteps = clearance.getElement(ray.position);
+
+				if (freeSteps > 0)
+				{
+					freeSteps--;
+					continue;
+				}
+
+				auto& connection = simulationSpace.getElement(ray.position)[ray.exitDirection()];
+
+				if (ray.reflections > 0)
+					reflect(ray, connection, exit, rays);
+
+				for (size_t band = 0; band < Bands; band++)
+				{
+					if (connection.absorption[band].affects())
+					{
+						AbsorptionCoefficient absorption = connection.absorption[band];
+						ray.powerCoefficients[band] = ray.powerCoefficients[band] * absorption.get<AbsorptionCoefficient::Unit::coefficient>(precision * (exit - ray.entry));
+					}
+				}
 			}
+		}
 
-			ray.position = ray.position + toBaseDirection(newOffset);
-			ray.offset = newOffset - direction;
+		statistics.rays += tracedRays;
+		statistics.steps += steps;
+		statistics.prunedRays += prunedRays;
+		statistics.prunedMargin += prunedMargin;
+	}
 
-			ray.previousDistance = distance;
+	// Replaces the tube by its two halves where it enters the current cell. Both of them keep pointing away from
+	// the (mirrored) transmitter, so they start off to the sides of the ray by a quarter of its width.
+	void split(const Ray& ray, std::vector<Ray>& rays) const
+	{
+		double spread = ray.spread / 2;
+		double width = ray.spread * (ray.distance / simulationSpace.precision + ray.entry);
 
-			rays.push_back(ray);
+		Point entry = ray.origin + ray.normalVector * ray.entry;
+		FreeVector side(-ray.normalVector.dy, ray.normalVector.dx);
+
+		for (int half : { -1, 1 })
+		{
+			double angle = half * spread / 2;
+
+			Point origin = entry + side * (half * width / 4);
+			DiscretePoint position((int)std::floor(origin.x), (int)std::floor(origin.y));
+
+			if (!simulationSpace.inRange(position))
+				continue;
+
+			FreeVector normalVector(
+				ray.normalVector.dx * std::cos(angle) - ray.normalVector.dy * std::sin(angle),
+				ray.normalVector.dx * std::sin(angle) + ray.normalVector.dy * std::cos(angle)
+			);
+
+			rays.push_back(Ray(
+				origin,
+				position,
+				normalVector,
+				ray.distance + simulationSpace.precision * ray.entry,
+				ray.reflections,
+				spread,
+				ray.powerCoefficients
+			));
+		}
+	}
+
+	// The reflected ray follows the normal of the first reflecting band; bands without a reflection carry no power.
+	void reflect(const Ray& ray, const ConnectionDistortion<Scalar, Bands>& connection, double exit, std::vector<Ray>& rays) const
+	{
+		int reflectingBand = -1;
+
+		for (size_t band = 0; band < Bands && reflectingBand < 0; band++)
+			if (connection.reflection[band].affects())
+				reflectingBand = (int)band;
+
+		if (reflectingBand < 0)
+			return;
+
+		std::array<PowerCoefficient, Bands> powerCoefficients;
+
+		for (size_t band = 0; band < Bands; band++)
+		{
+			ObstacleDistortion reflection = connection.reflection[band];
+			powerCoefficients[band] = ray.powerCoefficients[band] * reflection.coefficient;
+		}
+
+		ObstacleDistortion reflection = connection.reflection[reflectingBand];
+
+		rays.push_back(Ray(
+			ray.origin + ray.normalVector * exit,
+			ray.position,
+			ray.normalVector.reflectedBy(reflection.normalVector),
+			ray.distance + simulationSpace.precision * exit,
+			ray.reflections - 1,
+			ray.spread,
+			powerCoefficients
+		));
+	}
+
+public:
+	BasicRaycastingSignalSimulation(
+		SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition,
+		const std::array<Frequency, Bands>& frequencies,
+		RaycastingSignalSimulationParameters simulationParameters,
+		DistortionSpaceParameters distortionSpaceParameters = DistortionSpaceParameters()
+	) :
+		frequencies(frequencies),
+		simulationParameters(simulationParameters),
+		simulationSpace(simulationSpaceDefinition, baseDirections, frequencies, distortionSpaceParameters),
+		clearance(simulationSpace.surface, simulationSpace.precision)
+	{
+		computeClearance();
+	}
+
+	template<size_t B = Bands, typename = typename std::enable_if<B == 1>::type>
+	BasicRaycastingSignalSimulation(
+		SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition,
+		Frequency frequency,
+		RaycastingSignalSimulationParameters simulationParameters,
+		DistortionSpaceParameters distortionSpaceParameters = DistortionSpaceParameters()
+	) :
+		BasicRaycastingSignalSimulation(simulationSpaceDefinition, std::array<Frequency, Bands>{ { frequency } }, simulationParameters, distortionSpaceParameters)
+	{ }
+
+	virtual SignalMapPtr simulate(Position transmitterPosition) const
+	{
+		return simulateBands(transmitterPosition)[0];
+	}
+
+	// Rays only interact through the max-update of the maps, so with a thread pool the primary rays are traced
+	// in chunks, together with all of their reflections, straight into concurrent maps.
+	// The result does not depend on the order of the updates, so it is the same as the one of a serial run.
+	std::array<SignalMapPtr, Bands> simulateBands(Position transmitterPosition) const
+	{
+		std::array<std::shared_ptr<SignalMap>, Bands> signalMaps;
+		std::array<SignalMap*, Bands> targets;
+
+		for (size_t band = 0; band < Bands; band++)
+		{
+			signalMaps[band] = std::make_shared<SignalMap>(simulationSpace.surface, simulationSpace.precision);
+			targets[band] = signalMaps[band].get();
 		}
 
-		return signalMap;
+		auto minimumCoefficient = getMinimumCoefficient();
+
+		statistics.simulations++;
+
+		if (!simulationParameters.threadPool)
+		{
+			std::vector<Ray> rays;
+			std::vector<std::atomic<uint64_t>> dominance;
+			resetDominance(dominance);
+			castRays(transmitterPosition, 0, simulationParameters.raysCount, minimumCoefficient, targets, rays, dominance);
+
+			return toPointers(signalMaps);
+		}
+
+		std::array<std::unique_ptr<ConcurrentSignalMap>, Bands> concurrentSignalMaps;
+		std::array<ConcurrentSignalMap*, Bands> concurrentTargets;
+
+		for (size_t band = 0; band < Bands; band++)
+		{
+			concurrentSignalMaps[band].reset(new ConcurrentSignalMap(simulationSpace.surface, simulationSpace.precision));
+			concurrentTargets[band] = concurrentSignalMaps[band].get();
+		}
+
+		// All tasks share the dominance table, so which of two rays going the same way is pruned depends on the order
+		// in which they come; the one that goes on covers the cells of the other.
+		int tasks = (simulationParameters.raysCount + raysPerTask - 1) / raysPerTask;
+
+		std::vector<std::atomic<uint64_t>> dominance;
+		resetDominance(dominance);
+
+		simulationParameters.threadPool->parallelFor(tasks, [&](int task) {
+			std::vector<Ray> rays;
+
+			castRays(
+				transmitterPosition,
+				task * raysPerTask,
+				std::min(simulationParameters.raysCount, (task + 1) * raysPerTask),
+				minimumCoefficient,
+				concurrentTargets,
+				rays,
+				dominance
+			);
+		});
+
+		simulationParameters.threadPool->parallelFor(signalMaps[0]->resolution.height, [&](int y) {
+			for (size_t band = 0; band < Bands; band++)
+				concurrentSignalMaps[band]->copyTo(*signalMaps[band], y, y + 1);
+		});
+
+		return toPointers(signalMaps);
+	}
+
+	// Every transmitter is traced by a single task, so the thread pool of the parameters is not used here.
+	// With several bands the map of the given band of transmitter i is reported under index i * Bands + band.
+	virtual void simulateBatch(const std::vector<Position>& transmitterPositions, ThreadPoolPtr threadPool, SignalMapCallback callback) const
+	{
+		auto minimumCoefficient = getMinimumCoefficient();
+
+		runBatch<Scratch>(
+			transmitterPositions,
+			threadPool,
+			[this] { return std::unique_ptr<Scratch>(new Scratch(simulationSpace.surface, simulationSpace.precision)); },
+			[this, minimumCoefficient, &callback](int index, Position transmitterPosition, Scratch& scratch) {
+				std::array<SignalMap*, Bands> targets;
+
+				for (size_t band = 0; band < Bands; band++)
+				{
+					scratch.signalMaps[band]->clear();
+					targets[band] = scratch.signalMaps[band].get();
+				}
+
+				statistics.simulations++;
+				resetDominance(scratch.dominance);
+				castRays(transmitterPosition, 0, simulationParameters.raysCount, minimumCoefficient, targets, scratch.rays, scratch.dominance);
+
+				for (size_t band = 0; band < Bands; band++)
+					callback(index * (int)Bands + (int)band, *scratch.signalMaps[band]);
+			}
+		);
+	}
+
+	// Totals over all simulations run since construction or the last reset.
+	RaycastingSignalSimulationStatistics getStatistics() const
+	{
+		RaycastingSignalSimulationStatistics result;
+		result.simulations = statistics.simulations;
+		result.rays = statistics.rays;
+		result.steps = statistics.steps;
+		result.prunedRays = statistics.prunedRays;
+		result.prunedMargin = statistics.prunedMargin;
+
+		return result;
+	}
+
+	void resetStatistics()
+	{
+		statistics.simulations = 0;
+		statistics.rays = 0;
+		statistics.steps = 0;
+		statistics.prunedRays = 0;
+		statistics.prunedMargin = 0;
 	}
-};
\ No newline at end of file
+
+private:
+	static std::array<SignalMapPtr, Bands> toPointers(const std::array<std::shared_ptr<SignalMap>, Bands>& signalMaps)
+	{
+		std::array<SignalMapPtr, Bands> pointers;
+		std::copy(signalMaps.begin(), signalMaps.end(), pointers.begin());
+
+		return pointers;
+	}
+};
+using RaycastingSignalSimulation = BasicRaycastingSignalSimulation<double>;
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "CpuFeatures.hpp"
+
+#include <limits>
+
+// One output row of a bilinear resampling in dB. Every output column c interpolates between the columns left[c] and right[c]
+// of the lower and upper source rows, with weights (1 - fx[c], fx[c]) and (1 - fy, fy). Sources without a signal hold -infinity
+// and are left out of the mean; a pixel none of whose neighbours has a signal gets -infinity. The offset is added to every result.
+// The AVX2 version evaluates eight columns at a time with the same operations as the scalar one, so both give the same result.
+class ResampleRowKernel
+{
+public:
+	static void evaluate(const float* lower, const float* upper, float fy, const int* left, const int* right, const float* fx, float offset, float* out, int count)
+	{
+#if defined(SIGNAL_MAPPER_AVX2)
+		if (supportsAvx2())
+		{
+			evaluateAvx2(lower, upper, fy, left, right, fx, offset, out, count);
+			return;
+		}
+#endif
+
+		evaluateScalar(lower, upper, fy, left, right, fx, offset, out, 0, count);
+	}
+
+private:
+	static void evaluateScalar(const float* lower, const float* upper, float fy, const int* left, const int* right, const float* fx, float offset, float* out, int begin, int end)
+	{
+		const float none = -std::numeric_limits<float>::infinity();
+
+		for (int c = begin; c < end; c++)
+		{
+			float values[4] = { lower[left[c]], lower[right[c]], upper[left[c]], upper[right[c]] };
+			float weights[4] = { (1 - fx[c]) * (1 - fy), fx[c] * (1 - fy), (1 - fx[c]) * fy, fx[c] * fy };
+
+			float sum = 0;
+			float weight = 0;
+
+			for (int k = 0; k < 4; k++)
+			{
+				float valid = values[k] > none ? weights[k] : 0;
+
+				sum = sum + valid * (values[k] > none ? values[k] : 0);
+				weight = weight + valid;
+			}
+
+			out[c] = weight > 0 ? sum / weight + offset : none;
+		}
+	}
+
+#if defined(SIGNAL_MAPPER_AVX2)
+	SIGNAL_MAPPER_TARGET_AVX2
+	static void evaluateAvx2(const float* lower, const float* upper, float fy, const int* left, const int* right, const float* fx, float offset, float* out, int count)
+	{
+		const __m256 none = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1);
+		const __m256 fys = _mm256_set1_ps(fy);
+		const __m256 oneMinusFys = _mm256_sub_ps(one, fys);
+		const __m256 offsets = _mm256_set1_ps(offset);
+
+		int c = 0;
+
+		for (; c + 8 <= count; c += 8)
+		{
+			__m256i lefts = _mm256_loadu_si256((const __m256i*)(left + c));
+			__m256i rights = _mm256_loadu_si256((const __m256i*)(right + c));
+
+			__m256 fxs = _mm256_loadu_ps(fx + c);
+			__m256 oneMinusFxs = _mm256_sub_ps(one, fxs);
+
+			__m256 values[4] = {
+				_mm256_i32gather_ps(lower, lefts, 4),
+				_mm256_i32gather_ps(lower, rights, 4),
+				_mm256_i32gather_ps(upper, lefts, 4),
+				_mm256_i32gather_ps(upper, rights, 4)
+			};
+			__m256 weights[4] = {
+				_mm256_mul_ps(oneMinusFxs, oneMinusFys),
+				_mm256_mul_ps(fxs, oneMinusFys),
+				_mm256_mul_ps(oneMinusFxs, fys),
+				_mm256_mul_ps(fxs, fys)
+			};
+
+			__m256 sum = zero;
+			__m256 weight = zero;
+
+			for (int k = 0; k < 4; k++)
+			{
+				__m256 mask = _mm256_cmp_ps(values[k], none, _CMP_GT_OQ);
+				__m256 valid = _mm256_and_ps(weights[k], mask);
+
+				sum = _mm256_add_ps(sum, _mm256_mul_ps(valid, _mm256_and_ps(values[k], mask)));
+				weight = _mm256_add_ps(weight, valid);
+			}
+
+			__m256 result = _mm256_add_ps(_mm256_div_ps(sum, weight), offsets);
+			result = _mm256_blendv_ps(none, result, _mm256_cmp_ps(weight, zero, _CMP_GT_OQ));
+
+			_mm256_storeu_ps(out + c, result);
+		}
+
+		evaluateScalar(lower, upper, fy, left, right, fx, offset, out, c, count);
+	}
+#endif
+};
\ No newline at end of file
@@ -2,9 +2,14 @@
 
 #include "Transmitter.hpp"
 #include "SimulationSpace.hpp"
+#include "ThreadPool.hpp"
+#include "ResampleRowKernel.hpp"
 
 #include <vector>
 #include <functional>
+#include <atomic>
+#include <limits>
+#include <cmath>
 
 template<typename T>
 struct SmoothingFilter {
@@ -29,12 +34,24 @@ private:
 public:
 	SignalMap(Surface spaceSize, Distance precision) :
 		SimulationUniformFiniteElementsSpace(spaceSize, precision)
+	{
+		clear();
+	}
+
+	void clear()
 	{
 		for (int x = 0; x < resolution.width; x++)
 			for (int y = 0; y < resolution.height; y++)
 				getElement(DiscretePoint(x, y)) = PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(0);
 	}
 
+	void raise(const DiscretePoint& position, PowerCoefficient coefficient)
+	{
+		auto& element = getElement(position);
+		if (element < coefficient)
+			element = coefficient;
+	}
+
 	Power getSignalStrength(Position position, const Transmitter& transmitter, const Receiver& receiver) const
 	{
 		if (!inRange(position))
@@ -75,5 +92,146 @@ public:
 
 		return transmitter.power * transmitter.antenaGain * receiver.antenaGain * getSignalStrength(point, transmitter, receiver);
 	}
+
+	// Dense raster of the received power in dBm, row after row: pixel (column, row) samples the point
+	// (area.minX() + area.getWidth() * column / width, area.minY() + area.getHeight() * row / height).
+	// Every pixel is interpolated bilinearly in dB between the four cells around it, leaving out the ones without signal;
+	// pixels outside of the map or with no signal around get -infinity. The map is converted to dB once, the interpolation
+	// weights of every column are computed once, and rows are evaluated by the row kernel, in parallel if a pool is given.
+	std::vector<float> resample(const Rectangle& area, int width, int height, const Transmitter& transmitter, const Receiver& receiver, ThreadPoolPtr threadPool = nullptr) const
+	{
+		std::vector<float> raster((size_t)width * height);
+
+		resampleInBlocks(area, width, height, transmitter, receiver, [&](int firstRow, int lastRow, const float* rows) {
+			std::copy(rows, rows + (size_t)(lastRow - firstRow) * width, raster.data() + (size_t)firstRow * width);
+		}, height, threadPool);
+
+		return raster;
+	}
+
+	// The same raster handed to the consumer in consecutive blocks of at most blockHeight rows, so that it can be written out
+	// while it is computed without ever being held in memory as a whole.
+	void resampleInBlocks(
+		const Rectangle& area, int width, int height,
+		const Transmitter& transmitter, const Receiver& receiver,
+		const std::function<void(int firstRow, int lastRow, const float* rows)>& consumer,
+		int blockHeight = 256, ThreadPoolPtr threadPool = nullptr) const
+	{
+		const float none = -std::numeric_limits<float>::infinity();
+
+		int columns = resolution.width;
+		int rows = resolution.height;
+
+		std::vector<float> decibels((size_t)columns * rows);
+
+		parallelFor(threadPool, rows, [&](int y) {
+			for (int x = 0; x < columns; x++)
+			{
+				double coefficient = getElement(DiscretePoint(x, y)).get<PowerCoefficient::Unit::coefficient>();
+				decibels[(size_t)y * columns + x] = coefficient > 0 ? (float)(10 * std::log10(coefficient)) : none;
+			}
+		});
+
+		Point origin = getPosition(DiscretePoint(0, 0)).get<Distance::Unit::m>();
+		double unit = precision.get<Distance::Unit::m>();
+
+		std::vector<int> left(width);
+		std::vector<int> right(width);
+		std::vector<float> fx(width);
+		std::vector<int> outsideColumns;
+
+		for (int column = 0; column < width; column++)
+		{
+			double position = (area.minX() + area.getWidth() * column / width - origin.x) / unit;
+			int cell = (int)std::floor(position);
+
+			if (cell < 0 || cell >= columns)
+			{
+				outsideColumns.push_back(column);
+				cell = 0;
+			}
+
+			left[column] = cell;
+			right[column] = std::min(cell + 1, columns - 1);
+			fx[column] = (float)std::max(0., std::min(1., position - cell));
+		}
+
+		float offset = (float)(transmitter.power * transmitter.antenaGain * receiver.antenaGain).get<Power::Unit::dBm>();
+
+		blockHeight = std::max(1, std::min(blockHeight, height));
+
+		std::vector<float> block((size_t)width * blockHeight);
+
+		for (int firstRow = 0; firstRow < height; firstRow += blockHeight)
+		{
+			int lastRow = std::min(height, firstRow + blockHeight);
+
+			parallelFor(threadPool, lastRow - firstRow, [&](int index) {
+				int row = firstRow + index;
+				float* out = block.data() + (size_t)index * width;
+
+				double position = (area.minY() + area.getHeight() * row / height - origin.y) / unit;
+				int cell = (int)std::floor(position);
+
+				if (cell < 0 || cell >= rows)
+				{
+					std::fill(out, out + width, none);
+					return;
+				}
+
+				ResampleRowKernel::evaluate(
+					decibels.data() + (size_t)cell * columns,
+					decibels.data() + (size_t)std::min(cell + 1, rows - 1) * columns,
+					(float)(position - cell),
+					left.data(),
+					right.data(),
+					fx.data(),
+					offset,
+					out,
+					width
+				);
+
+				for (int column : outsideColumns)
+					out[column] = none;
+			});
+
+			consumer(firstRow, lastRow, block.data());
+		}
+	}
+};
+using SignalMapPtr = std::shared_ptr<const SignalMap>;
+
+// Signal map that many producers can write into at the same time. Every element is raised with a lock-free
+// compare-and-swap loop, so concurrent raises of one cell keep the strongest signal no matter their order.
+class ConcurrentSignalMap : public SimulationUniformFiniteElementsSpace<std::atomic<double>>
+{
+public:
+	ConcurrentSignalMap(Surface spaceSize, Distance precision) :
+		SimulationUniformFiniteElementsSpace(spaceSize, precision)
+	{ }
+
+	void raise(const DiscretePoint& position, PowerCoefficient coefficient)
+	{
+		auto& element = getElement(position);
+
+		double value = coefficient.get<PowerCoefficient::Unit::coefficient>();
+		double current = element.load(std::memory_order_relaxed);
+
+		while (current < value && !element.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{ }
+	}
+
+	PowerCoefficient getCoefficient(const DiscretePoint& position) const
+	{
+		return PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(getElement(position).load(std::memory_order_relaxed));
+	}
+
+	// Copies the given rows into a regular map; meant to be called once all producers are done.
+	void copyTo(SignalMap& signalMap, int firstRow, int lastRow) const
+	{
+		for (int y = firstRow; y < lastRow; y++)
+			for (int x = 0; x < resolution.width; x++)
+				signalMap.getElement(DiscretePoint(x, y)) = getCoefficient(DiscretePoint(x, y));
+	}
 };
-using SignalMapPtr = std::shared_ptr<const SignalMap>;
\ No newline at end of file
+using ConcurrentSignalMapPtr = std::shared_ptr<ConcurrentSignalMap>;
\ No newline at end of file
@@ -3,9 +3,13 @@
 #include "Physics.hpp"
 #include "SimulationSpace.hpp"
 #include "SignalMap.hpp"
+#include "ThreadPool.hpp"
 
 #include <vector>
 #include <algorithm>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 struct SignalSimulationSpaceDefinition
 {
@@ -17,13 +21,120 @@ struct SignalSimulationSpaceDefinition
 		obstacles(obstacles),
 		spaceSize(spaceSize),
 		precision(precision)
-	{ }
+	{
+		std::vector<Rectangle> obstaclesBounds;
+
+		for (const auto& obstacle : obstacles)
+			obstaclesBounds.push_back(obstacle->getBounds().get<Distance::Unit::m>());
+
+		obstaclesHierarchy = BoundingVolumeHierarchy(obstaclesBounds);
+	}
+
+	// Visits, in declaration order, only the obstacles whose bounds the begin-end segment touches.
+	template<typename Callback>
+	void forEachObstacle(Position begin, Position end, Callback&& callback) const
+	{
+		Vector vector(
+			begin.get<Distance::Unit::m>(),
+			end.get<Distance::Unit::m>()
+		);
+
+		obstaclesHierarchy.traverse(vector, 1., [this, &callback](int i) {
+			callback(obstacles[i]);
+		});
+	}
+
+	void fingerprint(Fingerprint& fingerprint, Frequency frequency) const
+	{
+		Rectangle surface = spaceSize.get<Distance::Unit::m>();
+
+		fingerprint
+			<< surface.minX() << surface.minY() << surface.maxX() << surface.maxY()
+			<< precision.get<Distance::Unit::m>()
+			<< frequency.get<Frequency::Unit::m>()
+			<< (int)obstacles.size();
+
+		for (const auto& obstacle : obstacles)
+			obstacle->fingerprint(fingerprint, frequency);
+	}
+
+private:
+	BoundingVolumeHierarchy obstaclesHierarchy;
 };
 using SignalSimulationSpaceDefinitionPtr = std::shared_ptr<const SignalSimulationSpaceDefinition>;
 
+// Receives the map of the transmitter with the given index. The map is only valid during the call,
+// as its memory is reused for the following transmitters, and calls can come from several threads at once.
+using SignalMapCallback = std::function<void(int, const SignalMap&)>;
+
 class SignalSimulation
 {
+protected:
+	// Runs simulate(index, position, scratch) for every transmitter on the pool; it is expected to report its maps.
+	// Scratch objects are only created when no finished task has returned one,
+	// so there are at most as many of them as tasks running at once.
+	template<typename Scratch, typename CreateScratch, typename Simulate>
+	static void runBatch(
+		const std::vector<Position>& transmitterPositions,
+		const ThreadPoolPtr& threadPool,
+		CreateScratch&& createScratch,
+		Simulate&& simulate)
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<Scratch>> scratches;
+
+		parallelFor(threadPool, (int)transmitterPositions.size(), [&](int i) {
+			std::unique_ptr<Scratch> scratch;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (!scratches.empty())
+				{
+					scratch = std::move(scratches.back());
+					scratches.pop_back();
+				}
+			}
+
+			if (!scratch)
+				scratch = createScratch();
+
+			simulate(i, transmitterPositions[i], *scratch);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			scratches.push_back(std::move(scratch));
+		});
+	}
+
+	// Reads the cell of every receiver; receivers outside of the map get no signal.
+	static std::vector<PowerCoefficient> sample(const SignalMap& signalMap, const std::vector<Position>& receiverPositions)
+	{
+		std::vector<PowerCoefficient> powerCoefficients;
+		powerCoefficients.reserve(receiverPositions.size());
+
+		for (const auto& receiverPosition : receiverPositions)
+			powerCoefficients.push_back(signalMap.inRange(receiverPosition) ? signalMap.getElement(receiverPosition) : PowerCoefficient());
+
+		return powerCoefficients;
+	}
+
 public:
 	virtual SignalMapPtr simulate(Position transmitterPosition) const = 0;
+
+	// Simulates many transmitters over the same preprocessed space, streaming every map to the callback once it is done.
+	virtual void simulateBatch(const std::vector<Position>& transmitterPositions, ThreadPoolPtr threadPool, SignalMapCallback callback) const
+	{
+		parallelFor(threadPool, (int)transmitterPositions.size(), [&](int i) {
+			callback(i, *simulate(transmitterPositions[i]));
+		});
+	}
+
+	// Power coefficient at every receiver, in the given order. Engines that can evaluate single points override it,
+	// so that the cost follows the number of receivers; by default the whole map is simulated and sampled.
+	// The raycasting and waveform simulations keep the default, so their queries cost as much as a full simulation.
+	virtual std::vector<PowerCoefficient> query(Position transmitterPosition, const std::vector<Position>& receiverPositions) const
+	{
+		return sample(*simulate(transmitterPosition), receiverPositions);
+	}
 };
 using SignalSimulationPtr = std::shared_ptr<SignalSimulation const>;
\ No newline at end of file
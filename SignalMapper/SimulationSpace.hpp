@@ -6,19 +6,20 @@
 #include <algorithm>
 #include <memory>
 
-template<typename Element>
-class SimulationUniformFiniteElementsSpace : public UniformFiniteElementsSpace<Element>
+template<typename Element, typename Storage = UniformFiniteElementsSpace<Element>>
+class SimulationUniformFiniteElementsSpace : public Storage
 {
 public:
 	const Surface surface;
 	const Distance precision;
 
-	SimulationUniformFiniteElementsSpace(const Surface& surface, const Distance& precision) :
-		UniformFiniteElementsSpace(
+	SimulationUniformFiniteElementsSpace(const Surface& surface, const Distance& precision, typename Storage::Elements elements = nullptr) :
+		Storage(
 			DiscreteSize( 
 				surface.get<Distance::Unit::m>().getWidth(), 
 				surface.get<Distance::Unit::m>().getHeight(), 
-				precision.get<Distance::Unit::m>())
+				precision.get<Distance::Unit::m>()),
+			elements
 		),
 		surface(surface),
 		precision(precision)
@@ -54,6 +55,24 @@ public:
 		return getDiscretePoint(position);
 	}
 
-	using UniformFiniteElementsSpace::getElement;
-	using UniformFiniteElementsSpace::inRange;
+	template<typename Callback>
+	void forEachElementInside(const Obstacle& obstacle, int firstRow, int lastRow, Callback&& callback) const
+	{
+		obstacle.rasterize(surface.minY(), precision, firstRow, lastRow, [this, &callback](int y, Distance begin, Distance end) {
+			int beginX = std::max(0, (int)std::ceil((begin - surface.minX()) / precision));
+			int endX = std::min(this->resolution.width, (int)std::ceil((end - surface.minX()) / precision));
+
+			for (int x = beginX; x < endX; x++)
+				callback(DiscretePoint(x, y));
+		});
+	}
+
+	template<typename Callback>
+	void forEachElementInside(const Obstacle& obstacle, Callback&& callback) const
+	{
+		forEachElementInside(obstacle, 0, this->resolution.height, std::forward<Callback>(callback));
+	}
+
+	using Storage::getElement;
+	using Storage::inRange;
 };
\ No newline at end of file
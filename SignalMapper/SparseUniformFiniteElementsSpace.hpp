@@ -0,0 +1,170 @@
+#pragma once
+
+#include "Math.hpp"
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Grid in which only occupied cells own an element. Occupancy is kept in a bitmap with a running
+// count per 64-bit word, so a lookup is a bit test plus one popcount. Free cells read as a default element.
+// Everything lives in one block of words: [count][bits...][ranks...][elements...], which can also be a mapped file.
+template<typename Element>
+class SparseUniformFiniteElementsSpace
+{
+public:
+	using Elements = std::shared_ptr<uint64_t>;
+
+	static const bool sparse = true;
+
+private:
+	static_assert(alignof(Element) <= alignof(uint64_t), "Elements are stored right after the occupancy words");
+
+	Elements block;
+
+	const uint64_t* bits;
+	const uint32_t* ranks;
+	Element* elements;
+
+	Element empty;
+
+	static size_t wordsCount(const DiscreteSize& resolution)
+	{
+		return ((size_t)resolution.width * resolution.height + 63) / 64;
+	}
+
+	static size_t headerWordsCount(const DiscreteSize& resolution)
+	{
+		size_t words = wordsCount(resolution);
+		return 1 + words + (words + 1) / 2;
+	}
+
+	static size_t blockSize(const DiscreteSize& resolution, size_t occupied)
+	{
+		return headerWordsCount(resolution) * sizeof(uint64_t) + occupied * sizeof(Element);
+	}
+
+	static int popcount(uint64_t word)
+	{
+#if defined(_MSC_VER) && defined(_WIN64)
+		return (int)__popcnt64(word);
+#elif defined(_MSC_VER)
+		return (int)(__popcnt((uint32_t)word) + __popcnt((uint32_t)(word >> 32)));
+#else
+		return __builtin_popcountll(word);
+#endif
+	}
+
+	void bind()
+	{
+		size_t words = wordsCount(resolution);
+
+		bits = block.get() + 1;
+		ranks = (const uint32_t*)(block.get() + 1 + words);
+		elements = (Element*)(block.get() + headerWordsCount(resolution));
+	}
+
+public:
+	const DiscreteSize resolution;
+
+	SparseUniformFiniteElementsSpace(const DiscreteSize& resolution, Elements elements = nullptr) :
+		block(elements),
+		empty(),
+		resolution(resolution)
+	{
+		if (!block)
+			occupy(std::vector<int>());
+		else
+			bind();
+	}
+
+	SparseUniformFiniteElementsSpace(const SparseUniformFiniteElementsSpace&) = delete;
+	SparseUniformFiniteElementsSpace& operator=(const SparseUniformFiniteElementsSpace&) = delete;
+
+	// Replaces the occupancy with the given ascending cell indices; all occupied elements start default.
+	void occupy(const std::vector<int>& indices)
+	{
+		size_t words = wordsCount(resolution);
+		size_t size = blockSize(resolution, indices.size());
+
+		block = Elements(new uint64_t[(size + sizeof(uint64_t) - 1) / sizeof(uint64_t)](), std::default_delete<uint64_t[]>());
+		block.get()[0] = indices.size();
+
+		uint64_t* newBits = block.get() + 1;
+		uint32_t* newRanks = (uint32_t*)(block.get() + 1 + words);
+
+		for (int index : indices)
+			newBits[index >> 6] |= 1ull << (index & 63);
+
+		uint32_t rank = 0;
+		for (size_t i = 0; i < words; i++)
+		{
+			newRanks[i] = rank;
+			rank += popcount(newBits[i]);
+		}
+
+		bind();
+
+		for (size_t i = 0; i < indices.size(); i++)
+			new (elements + i) Element();
+	}
+
+	bool occupied(const DiscretePoint& discretePoint) const
+	{
+		size_t index = (size_t)discretePoint.y * resolution.width + discretePoint.x;
+		return (bits[index >> 6] >> (index & 63)) & 1;
+	}
+
+	// Only occupied cells can be modified.
+	Element& getElement(const DiscretePoint& discretePoint)
+	{
+		return const_cast<Element&>(static_cast<const SparseUniformFiniteElementsSpace&>(*this).getElement(discretePoint));
+	}
+
+	const Element& getElement(const DiscretePoint& discretePoint) const
+	{
+		size_t index = (size_t)discretePoint.y * resolution.width + discretePoint.x;
+
+		uint64_t word = bits[index >> 6];
+		uint64_t mask = 1ull << (index & 63);
+
+		if (!(word & mask))
+			return empty;
+
+		return elements[ranks[index >> 6] + popcount(word & (mask - 1))];
+	}
+
+	bool inRange(const DiscretePoint& point) const
+	{
+		return
+			point.x >= 0 &&
+			point.x < resolution.width &&
+			point.y >= 0 &&
+			point.y < resolution.height;
+	}
+
+	size_t occupiedCount() const { return (size_t)block.get()[0]; }
+
+	const void* data() const { return block.get(); }
+	size_t dataSize() const { return blockSize(resolution, occupiedCount()); }
+
+	// Adopts a block that was previously written out from data(), after checking that its size is consistent.
+	static Elements adopt(std::shared_ptr<void> owner, void* data, size_t size, const DiscreteSize& resolution)
+	{
+		if (size < headerWordsCount(resolution) * sizeof(uint64_t))
+			return nullptr;
+
+		uint64_t* words = (uint64_t*)data;
+
+		if (size != blockSize(resolution, (size_t)words[0]))
+			return nullptr;
+
+		return Elements(owner, words);
+	}
+};
\ No newline at end of file
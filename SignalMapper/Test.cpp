@@ -6,7 +6,11 @@
 #include "RaycastingSignalSimulation.hpp"
 #include "FriisSignalSimulation.hpp"
 #include "BFSSignalSimulation.hpp"
+#include "EikonalSignalSimulation.hpp"
+#include "WaveformSignalSimulation.hpp"
+#include "ImageSourceSignalSimulation.hpp"
 #include "BuildingMap.hpp"
+#include "RasterWriter.hpp"
 
 using namespace std;
 
@@ -14,7 +18,10 @@ enum SimulationType
 {
 	Ray,
 	Friis,
-	BFS
+	BFS,
+	Eikonal,
+	Waveform,
+	ImageSource
 };
 
 int main()
@@ -171,6 +178,41 @@ int main()
 		signalSimulation = std::make_shared<BFSSignalSimulation>(simulationSpace, frequency, simulationParameters);
 		break;
 	}
+	case SimulationType::Eikonal:
+	{
+		filename = "eikonal";
+		EikonalSignalSimulationParameters simulationParameters(
+			transmitter,
+			receiver,
+			Power::in<Power::Unit::dBm>(-70),
+			AbsorptionCoefficient::in<AbsorptionCoefficient::Unit::dB>(-20, Distance::in<Distance::Unit::m>(1))
+		);
+		signalSimulation = std::make_shared<EikonalSignalSimulation>(simulationSpace, frequency, simulationParameters);
+		break;
+	}
+	case SimulationType::Waveform:
+	{
+		filename = "waveform";
+		WaveformSignalSimulationParameters simulationParameters(
+			transmitter,
+			receiver,
+			Power::in<Power::Unit::dBm>(-70)
+		);
+		signalSimulation = std::make_shared<WaveformSignalSimulation>(simulationSpace, frequency, simulationParameters);
+		break;
+	}
+	case SimulationType::ImageSource:
+	{
+		filename = "image";
+		ImageSourceSignalSimulationParameters simulationParameters(
+			3,
+			transmitter,
+			receiver,
+			Power::in<Power::Unit::dBm>(-70)
+		);
+		signalSimulation = std::make_shared<ImageSourceSignalSimulation>(simulationSpace, frequency, simulationParameters);
+		break;
+	}
 	}
 
 	cout << "Simulating" << endl;
@@ -189,52 +231,27 @@ int main()
 
 	cout << "Finished" << endl;
 
-	fstream file;
-	file.open("Out/" + filename + ".pgm", ios::out);
+	Rectangle imageArea(boundingBox.minX(), boundingBox.minY(), boundingBox.minX() + buildingLongerSide, boundingBox.minY() + buildingLongerSide);
 
-	file << "P2\n";
-	file << imageSize << ' ' << imageSize << ' ' << 256 << "\n";
-
-	for (size_t i = 0; i < imageSize; i++)
-	{
-		for (size_t u = 0; u < imageSize; u++)
-		{
-			Position position = Position::in<Distance::Unit::m>(
-				Point(
-					boundingBox.minX() + buildingLongerSide * i / imageSize,
-					boundingBox.minY() + buildingLongerSide * u / imageSize
-				)
-				);
+	int imageWidth = (int)imageSize;
+	int imageHeight = (int)imageSize;
 
-			int color = 0;
-
-			if (buildingMap->hasObstacle(position))
-				color = 50;
-			else
-			{
-				Power strength = signalMap->getSignalStrength(position, transmitter, receiver);
-
-				if (strength.get<Power::Unit::dBW>() != 0)
-				{
-					double signal = strength.get<Power::Unit::dBm>();
-
-					// -30 (best) - -70(worst) 
-					signal = (signal + 70.) / 40.;
-
-					signal = std::max(signal, 0.);
-					signal = std::min(signal, 1.);
-
-					color = (int)(255 * signal);
-				}
-			}
+	std::vector<RasterWriterPtr> writers{
+		std::make_shared<PGMRasterWriter>("Out/" + filename + ".pgm", imageWidth, imageHeight, Power::in<Power::Unit::dBm>(-70), Power::in<Power::Unit::dBm>(-30)),
+		std::make_shared<PaletteRasterWriter>("Out/" + filename + ".bmp", imageWidth, imageHeight, Power::in<Power::Unit::dBm>(-70), Power::in<Power::Unit::dBm>(-30)),
+		std::make_shared<FloatRasterWriter>("Out/" + filename + ".raster", imageWidth, imageHeight, imageArea)
+	};
 
-			file << color << ' ';
-		}
+	signalMap->resampleInBlocks(imageArea, imageWidth, imageHeight, transmitter, receiver, [&](int firstRow, int lastRow, const float* signals) {
+		std::vector<uint8_t> walls = buildingMap->resample(imageArea, imageWidth, imageHeight, firstRow, lastRow);
 
-		file << "\n";
-	}
+		for (const auto& writer : writers)
+			writer->write(signals, walls.data(), lastRow - firstRow);
+	});
 
-	file.close();
+	for (const auto& writer : writers)
+		if (!writer->close())
+			cout << "Could not save the image" << endl;
 
 	//cin.get();
 }
\ No newline at end of file
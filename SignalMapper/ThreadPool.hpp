@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+class ThreadPool
+{
+private:
+	struct Loop
+	{
+		std::function<void(int)> task;
+		int count;
+
+		std::atomic<int> next;
+		std::atomic<int> finished;
+
+		std::mutex mutex;
+		std::condition_variable done;
+
+		Loop(std::function<void(int)> task, int count) :
+			task(task),
+			count(count),
+			next(0),
+			finished(0)
+		{ }
+
+		void run()
+		{
+			int completed = 0;
+
+			for (int i = next++; i < count; i = next++)
+			{
+				task(i);
+				completed++;
+			}
+
+			if (completed > 0 && (finished += completed) == count)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				done.notify_all();
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+
+	std::mutex mutex;
+	std::condition_variable available;
+	bool stopping = false;
+
+	void work()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				available.wait(lock, [this] { return stopping || !tasks.empty(); });
+
+				if (tasks.empty())
+					return;
+
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+
+			task();
+		}
+	}
+
+public:
+	ThreadPool(int threadsCount = std::max(1u, std::thread::hardware_concurrency()))
+	{
+		for (int i = 0; i < threadsCount; i++)
+			workers.push_back(std::thread(&ThreadPool::work, this));
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		available.notify_all();
+
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	int size() const
+	{
+		return (int)workers.size();
+	}
+
+	void submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+
+		available.notify_one();
+	}
+
+	// Runs task(i) for every i in [0, count) and returns once all of them are finished.
+	// The calling thread takes part in the loop, so it is safe to call from within a pooled task.
+	void parallelFor(int count, std::function<void(int)> task)
+	{
+		if (count <= 0)
+			return;
+
+		auto loop = std::make_shared<Loop>(std::move(task), count);
+
+		int helpers = std::min(size(), count - 1);
+		for (int i = 0; i < helpers; i++)
+			submit([loop] { loop->run(); });
+
+		loop->run();
+
+		std::unique_lock<std::mutex> lock(loop->mutex);
+		loop->done.wait(lock, [&loop] { return loop->finished == loop->count; });
+	}
+};
+using ThreadPoolPtr = std::shared_ptr<ThreadPool>;
+
+template<typename Task>
+void parallelFor(const ThreadPoolPtr& threadPool, int count, Task&& task)
+{
+	if (threadPool)
+		threadPool->parallelFor(count, std::forward<Task>(task));
+	else
+		for (int i = 0; i < count; i++)
+			task(i);
+}
\ No newline at end of file
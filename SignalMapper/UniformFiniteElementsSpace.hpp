@@ -4,32 +4,64 @@
 
 #include <array>
 #include <vector>
+#include <memory>
 #include <math.h>
 #include <algorithm>
 
 template<typename Element>
 class UniformFiniteElementsSpace
 {
+public:
+	using Elements = std::shared_ptr<Element>;
+
+	static const bool sparse = false;
+
 protected:
-	std::vector<Element> elements;
+	Elements elements;
 
 public:
 	const DiscreteSize resolution;
 
-	UniformFiniteElementsSpace(const DiscreteSize& resolution) :
+	// The elements can be provided from the outside (for example from a mapped file), otherwise they are allocated.
+	UniformFiniteElementsSpace(const DiscreteSize& resolution, Elements elements = nullptr) :
+		elements(elements),
 		resolution(resolution)
 	{
-		elements = std::vector<Element>(resolution.width * resolution.height);
+		if (!this->elements)
+			this->elements = std::shared_ptr<Element>(new Element[resolution.width * resolution.height](), std::default_delete<Element[]>());
 	}
 
+	UniformFiniteElementsSpace(const UniformFiniteElementsSpace&) = delete;
+	UniformFiniteElementsSpace& operator=(const UniformFiniteElementsSpace&) = delete;
+
 	Element& getElement(const DiscretePoint& discretePoint)
 	{
-		return elements[discretePoint.y * resolution.width + discretePoint.x];
+		return elements.get()[discretePoint.y * resolution.width + discretePoint.x];
 	}
 
 	const Element& getElement(const DiscretePoint& discretePoint) const
 	{
-		return elements[discretePoint.y * resolution.width + discretePoint.x];
+		return elements.get()[discretePoint.y * resolution.width + discretePoint.x];
+	}
+
+	// Every cell of a dense space owns an element, so there is nothing to occupy.
+	void occupy(const std::vector<int>& indices)
+	{ }
+
+	bool occupied(const DiscretePoint& discretePoint) const
+	{
+		return true;
+	}
+
+	const void* data() const { return elements.get(); }
+	size_t dataSize() const { return sizeof(Element) * resolution.width * resolution.height; }
+
+	static Elements adopt(std::shared_ptr<void> owner, void* data, size_t size, const DiscreteSize& resolution)
+	{
+		if (size != sizeof(Element) * resolution.width * resolution.height)
+			return nullptr;
+
+		return Elements(owner, (Element*)data);
 	}
 
 	bool inRange(const DiscretePoint& point) const
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "CpuFeatures.hpp"
+
+// One row of the damped wave equation leapfrog: next[i] = a[i] * current[i] - b[i] * previous[i] + c[i] * laplacian[i],
+// where the laplacian is taken from the row itself (current[i - 1] and current[i + 1]) and the rows above and below.
+// The result is written over previous, which is read only at the same index. The AVX2 version evaluates eight cells
+// at a time with the same operations in the same order, so both versions give the same result.
+class WaveStencilKernel
+{
+public:
+	static void evaluate(const float* a, const float* b, const float* c, const float* current, const float* north, const float* south, float* previous, int count)
+	{
+#if defined(SIGNAL_MAPPER_AVX2)
+		if (supportsAvx2())
+		{
+			evaluateAvx2(a, b, c, current, north, south, previous, count);
+			return;
+		}
+#endif
+
+		evaluateScalar(a, b, c, current, north, south, previous, 0, count);
+	}
+
+private:
+	static void evaluateScalar(const float* a, const float* b, const float* c, const float* current, const float* north, const float* south, float* previous, int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			float laplacian = ((current[i - 1] + current[i + 1]) + (north[i] + south[i])) - 4.f * current[i];
+			previous[i] = (a[i] * current[i] - b[i] * previous[i]) + c[i] * laplacian;
+		}
+	}
+
+#if defined(SIGNAL_MAPPER_AVX2)
+	SIGNAL_MAPPER_TARGET_AVX2
+	static void evaluateAvx2(const float* a, const float* b, const float* c, const float* current, const float* north, const float* south, float* previous, int count)
+	{
+		const __m256 four = _mm256_set1_ps(4.f);
+
+		int i = 0;
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 center = _mm256_loadu_ps(current + i);
+
+			__m256 laplacian = _mm256_sub_ps(
+				_mm256_add_ps(
+					_mm256_add_ps(_mm256_loadu_ps(current + i - 1), _mm256_loadu_ps(current + i + 1)),
+					_mm256_add_ps(_mm256_loadu_ps(north + i), _mm256_loadu_ps(south + i))
+				),
+				_mm256_mul_ps(four, center)
+			);
+
+			__m256 next = _mm256_add_ps(
+				_mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(a + i), center), _mm256_mul_ps(_mm256_loadu_ps(b + i), _mm256_loadu_ps(previous + i))),
+				_mm256_mul_ps(_mm256_loadu_ps(c + i), laplacian)
+			);
+
+			_mm256_storeu_ps(previous + i, next);
+		}
+
+		evaluateScalar(a, b, c, current, north, south, previous, i, count);
+	}
+#endif
+};
\ No newline at end of file
@@ -1,99 +1,363 @@
-//#pragma once
+#pragma once
+
+#include "SignalSimulation.hpp"
+#include "PenetrationMap.hpp"
+#include "WaveStencilKernel.hpp"
+#include "ThreadPool.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+
+struct WaveformSignalSimulationParameters {
+	Transmitter bestTransmitter;
+	Receiver bestReceiver;
+	Power minimumPower;
+	int cellsPerWavelength;
+	double crossings;
+	int averagedPeriods;
+	ThreadPoolPtr threadPool;
+	int tileSize;
+	int timeBlock;
+
+	WaveformSignalSimulationParameters(
+		Transmitter bestTransmitter,
+		Receiver bestReceiver,
+		Power minimumPower,
+		int cellsPerWavelength = 16,
+		double crossings = 2,
+		int averagedPeriods = 4,
+		ThreadPoolPtr threadPool = nullptr,
+		int tileSize = 128,
+		int timeBlock = 8
+	) :
+		bestTransmitter(bestTransmitter),
+		bestReceiver(bestReceiver),
+		minimumPower(minimumPower),
+		cellsPerWavelength(cellsPerWavelength),
+		crossings(crossings),
+		averagedPeriods(averagedPeriods),
+		threadPool(threadPool),
+		tileSize(tileSize),
+		timeBlock(timeBlock)
+	{ }
+};
+
+// Time-domain solution of the damped scalar wave equation u_tt + 2 gamma u_t = v^2 laplacian(u) on a grid of cellsPerWavelength
+// cells per free-space wavelength (or of the map's cells, if they are finer). Inside of obstacles the wave slows down to the speed
+// that gives the reflection of their material at normal incidence and is damped by their absorption; an absorbing layer two
+// wavelengths wide around the map soaks up the outgoing waves. The transmitter is a continuous sine source, and once the waves have
+// crossed the space the given number of times the squared field is averaged over averagedPeriods periods. A point source in 2D spreads
+// as 1 / r instead of 1 / r^2, so the averaged power is scaled by 2 lambda / r: in free space that gives exactly the Friis gain, and the
+// interference and the obstacles act on top of it.
 //
-//#include "SignalSimulation.hpp"
-//
-//#include <vector>
-//#include <algorithm>
-//
-//struct WaveformSignalSimulationParameters {
-//	WaveformSignalSimulationParameters()
-//	{ }
-//};
-//
-//struct WaveformSignalSimulationDistortion
-//{
-//	AbsorptionCoefficient absorption;
-//	ObstacleDistortion reflection;
-//
-//	WaveformSignalSimulationDistortion()
-//	{}
-//};
-//
-//class WaveformSignalSimulation
-//{
-//private:
-//	struct Ray
-//	{
-//		DiscretePoint position;
-//
-//		Position source;
-//		Distance distance;
-//		Distance previousDistance;
-//
-//		FreeVector normalVector;
-//		FreeVector offset;
-//
-//		int reflections = 0;
-//
-//		PowerCoefficient powerCoefficient;
-//
-//		Ray(Position source, DiscretePoint position, FreeVector normalVector, int reflections) :
-//			source(source),
-//			position(position),
-//			normalVector(normalVector.normalized()),
-//			reflections(reflections),
-//			powerCoefficient(PowerCoefficient::in<PowerCoefficient::Unit::coefficient>(1))
-//		{ }
-//	};
-//
-//	const Frequency frequency;
-//	const WaveformSignalSimulationParameters simulationParameters;
-//
-//	ConnectionsSpace<WaveformSignalSimulationDistortion> simulationSpace;
-//
-//public:
-//	WaveformSignalSimulation(SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition, Frequency frequency, WaveformSignalSimulationParameters simulationParameters = WaveformSignalSimulationParameters()) :
-//		frequency(frequency),
-//		simulationParameters(simulationParameters),
-//		simulationSpace(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision)
-//	{
-//		const auto directions = DiscreteDirection::baseDirections();
-//
-//		for (const auto& obstacle : simulationSpaceDefinition->obstacles)
-//		{
-//			for (int x = 0; x < simulationSpace.resolution.width; x++)
-//			{
-//				for (int y = 0; y < simulationSpace.resolution.height; y++)
-//				{
-//					DiscretePoint firstDiscretePosition(x, y);
-//					Position firstPosition = simulationSpace.getPosition(firstDiscretePosition);
-//
-//					auto& element = simulationSpace.getElement(firstDiscretePosition);
-//
-//					for (int i = 0; i < directions.size(); i++)
-//					{
-//						DiscretePoint secondDiscretePosition = firstDiscretePosition + directions[i];
-//						Position secondPosition = simulationSpace.getPosition(secondDiscretePosition);
-//
-//						auto& connection = element[i];
-//
-//						auto absorption = obstacle->absorption(firstPosition, secondPosition, frequency);
-//						connection.absorption = connection.absorption + absorption;
-//
-//						auto distortion = obstacle->distortion(firstPosition, secondPosition, frequency);
-//						connection.reflection = connection.reflection + distortion;
-//					}
-//				}
-//			}
-//		}
-//	}
-//
-//	virtual SignalMapPtr simulate(Position transmitterPosition) const
-//	{
-//		auto signalMap = std::make_shared<SignalMap>(simulationSpace.surface, simulationSpace.precision);
-//
-//
-//
-//		return signalMap;
-//	}
-//};
\ No newline at end of file
+// The grid is advanced in tiles, timeBlock steps at a time. Every tile copies itself with a halo of timeBlock cells into a local buffer,
+// steps it there (the valid part shrinks by a cell per step) and writes its interior into the second copy of the grid, so the tiles
+// of one block are independent and run on the pool. The result does not depend on the tiling or on the number of threads.
+class WaveformSignalSimulation : public SignalSimulation
+{
+private:
+	// Free-space wave speed in cells per time step; a five-point stencil is stable up to 1 / sqrt(2).
+	static constexpr double courant = 0.7;
+	static const int spongeWavelengths = 2;
+	// Amplitude reflection is capped, as the wave speed inside of a perfect reflector would drop to zero.
+	static constexpr double maximumReflection = 0.9;
+	static const int chunksPerThread = 4;
+
+	const Frequency frequency;
+	const WaveformSignalSimulationParameters simulationParameters;
+	const SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition;
+
+	double step;
+	Point origin;
+	int width;
+	int height;
+
+	// The fields are surrounded by a frame of timeBlock cells that always stays at zero, so that a tile's halo never leaves them.
+	int padding;
+	int stride;
+
+	// Per-cell coefficients of the update next = selfCoefficient * current - previousCoefficient * previous + laplacianCoefficient * laplacian.
+	std::vector<float> selfCoefficients;
+	std::vector<float> previousCoefficients;
+	std::vector<float> laplacianCoefficients;
+
+	struct Fields
+	{
+		std::vector<float> current;
+		std::vector<float> previous;
+		std::vector<float> nextCurrent;
+		std::vector<float> nextPrevious;
+
+		// Sum of the squared field of every cell over the averaged steps.
+		std::vector<double> power;
+	};
+
+	int tilesInRow() const
+	{
+		return (width + simulationParameters.tileSize - 1) / simulationParameters.tileSize;
+	}
+
+	int tilesCount() const
+	{
+		return tilesInRow() * ((height + simulationParameters.tileSize - 1) / simulationParameters.tileSize);
+	}
+
+	double wavelength() const
+	{
+		return frequency.get<Frequency::Unit::m>();
+	}
+
+	// Source term of the given step, raised over the first two periods to keep the start-up transient small.
+	float source(int n) const
+	{
+		double stepsPerPeriod = wavelength() / (courant * step);
+		double amplitude = n < 2 * stepsPerPeriod ? (1 - std::cos(3.141592653589793238463 * n / (2 * stepsPerPeriod))) / 2 : 1;
+
+		return (float)(amplitude * std::sin(2 * 3.141592653589793238463 * n / stepsPerPeriod));
+	}
+
+	// Advances one tile by steps time steps after the first one, from the current fields into the next ones.
+	void advance(int tile, int first, int steps, int sourceIndex, int averagedFrom, Fields& fields, std::vector<float>& buffer) const
+	{
+		int tileSize = simulationParameters.tileSize;
+
+		int firstX = tile % tilesInRow() * tileSize;
+		int firstY = tile / tilesInRow() * tileSize;
+		int lastX = std::min(width, firstX + tileSize);
+		int lastY = std::min(height, firstY + tileSize);
+
+		int localWidth = lastX - firstX + 2 * steps;
+		int localHeight = lastY - firstY + 2 * steps;
+
+		buffer.resize(2 * (size_t)localWidth * localHeight);
+
+		float* current = buffer.data();
+		float* previous = buffer.data() + (size_t)localWidth * localHeight;
+
+		// Index in the padded fields of the local cell (0, 0).
+		int corner = (firstY - steps + padding) * stride + firstX - steps + padding;
+
+		for (int row = 0; row < localHeight; row++)
+		{
+			std::memcpy(current + row * localWidth, fields.current.data() + corner + row * stride, localWidth * sizeof(float));
+			std::memcpy(previous + row * localWidth, fields.previous.data() + corner + row * stride, localWidth * sizeof(float));
+		}
+
+		int sourceRow = sourceIndex / stride - corner / stride;
+		int sourceColumn = sourceIndex % stride - corner % stride;
+
+		for (int s = 1; s <= steps; s++)
+		{
+			for (int row = s; row < localHeight - s; row++)
+			{
+				int global = corner + row * stride + s;
+				float* local = current + row * localWidth + s;
+
+				WaveStencilKernel::evaluate(
+					selfCoefficients.data() + global,
+					previousCoefficients.data() + global,
+					laplacianCoefficients.data() + global,
+					local,
+					local - localWidth,
+					local + localWidth,
+					previous + row * localWidth + s,
+					localWidth - 2 * s
+				);
+			}
+
+			if (sourceRow >= s && sourceRow < localHeight - s && sourceColumn >= s && sourceColumn < localWidth - s)
+				previous[sourceRow * localWidth + sourceColumn] += laplacianCoefficients[sourceIndex] * source(first + s);
+
+			std::swap(current, previous);
+
+			if (first + s < averagedFrom)
+				continue;
+
+			for (int row = steps; row < localHeight - steps; row++)
+			{
+				const float* values = current + row * localWidth + steps;
+				double* power = fields.power.data() + (firstY + row - steps) * width + firstX;
+
+				for (int x = 0; x < lastX - firstX; x++)
+					power[x] += (double)values[x] * values[x];
+			}
+		}
+
+		for (int row = steps; row < localHeight - steps; row++)
+		{
+			int global = corner + row * stride + steps;
+
+			std::memcpy(fields.nextCurrent.data() + global, current + row * localWidth + steps, (lastX - firstX) * sizeof(float));
+			std::memcpy(fields.nextPrevious.data() + global, previous + row * localWidth + steps, (lastX - firstX) * sizeof(float));
+		}
+	}
+
+public:
+	WaveformSignalSimulation(SignalSimulationSpaceDefinitionPtr simulationSpaceDefinition, Frequency frequency, WaveformSignalSimulationParameters simulationParameters) :
+		frequency(frequency),
+		simulationParameters(simulationParameters),
+		simulationSpaceDefinition(simulationSpaceDefinition),
+		padding(std::max(1, simulationParameters.timeBlock))
+	{
+		step = std::min(simulationSpaceDefinition->precision.get<Distance::Unit::m>(), wavelength() / simulationParameters.cellsPerWavelength);
+
+		double sponge = spongeWavelengths * wavelength();
+		Rectangle area = simulationSpaceDefinition->spaceSize.get<Distance::Unit::m>();
+
+		SignalSimulationSpaceDefinition waveSpaceDefinition(
+			simulationSpaceDefinition->obstacles,
+			Surface::in<Distance::Unit::m>(Rectangle(area.minX() - sponge, area.minY() - sponge, area.maxX() + sponge, area.maxY() + sponge)),
+			Distance::in<Distance::Unit::m>(step)
+		);
+
+		AbsorptionMap<> absorptionMap(waveSpaceDefinition, { { frequency } });
+		SimulationUniformFiniteElementsSpace<double> reflections(waveSpaceDefinition.spaceSize, waveSpaceDefinition.precision);
+
+		width = reflections.resolution.width;
+		height = reflections.resolution.height;
+		origin = reflections.getPosition(DiscretePoint(0, 0)).get<Distance::Unit::m>();
+		stride = width + 2 * padding;
+
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				reflections.getElement(DiscretePoint(x, y)) = 0;
+
+		for (const auto& obstacle : waveSpaceDefinition.obstacles)
+		{
+			reflections.forEachElementInside(*obstacle, [&](const DiscretePoint& point) {
+				double reflection = std::sqrt(obstacle->reflection(reflections.getPosition(point), frequency).get<PowerCoefficient::Unit::coefficient>());
+				reflections.getElement(point) = std::max(reflections.getElement(point), reflection);
+			});
+		}
+
+		size_t cells = (size_t)stride * (height + 2 * padding);
+
+		selfCoefficients.assign(cells, 0);
+		previousCoefficients.assign(cells, 0);
+		laplacianCoefficients.assign(cells, 0);
+
+		double spongeCells = sponge / step;
+		double spongeDamping = 12 * courant / spongeCells;
+
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				DiscretePoint point(x, y);
+
+				double reflection = reflections.getElement(point) < maximumReflection ? reflections.getElement(point) : maximumReflection;
+				double speed = courant * (1 - reflection) / (1 + reflection);
+
+				double absorption = absorptionMap.getAbsorption(point).get<AbsorptionCoefficient::Unit::alpha>(Distance::in<Distance::Unit::m>(1));
+				double damping = std::max(0., absorption) * step * speed / 2;
+
+				double depth = std::max(0., spongeCells - std::min(std::min(x, width - 1 - x), std::min(y, height - 1 - y))) / spongeCells;
+				damping += spongeDamping * depth * depth;
+
+				size_t index = (size_t)(y + padding) * stride + x + padding;
+
+				selfCoefficients[index] = (float)(2 / (1 + damping));
+				previousCoefficients[index] = (float)((1 - damping) / (1 + damping));
+				laplacianCoefficients[index] = (float)(speed * speed / (1 + damping));
+			}
+		}
+	}
+
+	virtual SignalMapPtr simulate(Position transmitterPosition) const
+	{
+		auto signalMap = std::make_shared<SignalMap>(simulationSpaceDefinition->spaceSize, simulationSpaceDefinition->precision);
+
+		Point transmitter = transmitterPosition.get<Distance::Unit::m>();
+
+		int sourceX = (int)std::floor((transmitter.x - origin.x) / step + 0.5);
+		int sourceY = (int)std::floor((transmitter.y - origin.y) / step + 0.5);
+
+		if (sourceX < 0 || sourceX >= width || sourceY < 0 || sourceY >= height)
+			return signalMap;
+
+		int sourceIndex = (sourceY + padding) * stride + sourceX + padding;
+
+		double stepsPerPeriod = wavelength() / (courant * step);
+		int averagedFrom = (int)std::ceil(simulationParameters.crossings * std::hypot(width, height) / courant);
+		int averagedSteps = std::max(1, (int)std::round(simulationParameters.averagedPeriods * stepsPerPeriod));
+		int steps = averagedFrom + averagedSteps - 1;
+
+		Fields fields;
+		size_t cells = (size_t)stride * (height + 2 * padding);
+
+		fields.current.assign(cells, 0);
+		fields.previous.assign(cells, 0);
+		fields.nextCurrent.assign(cells, 0);
+		fields.nextPrevious.assign(cells, 0);
+		fields.power.assign((size_t)width * height, 0);
+
+		ThreadPool* threadPool = simulationParameters.threadPool.get();
+		int chunks = std::min(tilesCount(), threadPool ? (threadPool->size() + 1) * chunksPerThread : 1);
+
+		for (int first = 0; first < steps; first += padding)
+		{
+			int blockSteps = std::min(padding, steps - first);
+
+			parallelFor(simulationParameters.threadPool, chunks, [&](int chunk) {
+				std::vector<float> buffer;
+
+				for (int tile = tilesCount() * chunk / chunks; tile < tilesCount() * (chunk + 1) / chunks; tile++)
+					advance(tile, first, blockSteps, sourceIndex, averagedFrom, fields, buffer);
+			});
+
+			std::swap(fields.current, fields.nextCurrent);
+			std::swap(fields.previous, fields.nextPrevious);
+		}
+
+		// Every map cell takes the mean power of the wave cells whose sample points fall into it.
+		Rectangle surface = signalMap->surface.get<Distance::Unit::m>();
+		double precision = signalMap->precision.get<Distance::Unit::m>();
+
+		std::vector<int> columns(width);
+		for (int x = 0; x < width; x++)
+			columns[x] = (int)std::floor((origin.x + step * x - surface.minX()) / precision);
+
+		std::vector<double> sums((size_t)signalMap->resolution.width * signalMap->resolution.height, 0);
+		std::vector<int> counts(sums.size(), 0);
+
+		for (int y = 0; y < height; y++)
+		{
+			int row = (int)std::floor((origin.y + step * y - surface.minY()) / precision);
+
+			if (row < 0 || row >= signalMap->resolution.height)
+				continue;
+
+			for (int x = 0; x < width; x++)
+			{
+				if (columns[x] < 0 || columns[x] >= signalMap->resolution.width)
+					continue;
+
+				size_t index = (size_t)row * signalMap->resolution.width + columns[x];
+
+				sums[index] += fields.power[(size_t)y * width + x];
+				counts[index]++;
+			}
+		}
+
+		for (int y = 0; y < signalMap->resolution.height; y++)
+		{
+			for (int x = 0; x < signalMap->resolution.width; x++)
+			{
+				size_t index = (size_t)y * signalMap->resolution.width + x;
+
+				if (!counts[index])
+					continue;
+
+				double distance = std::max(step, transmitterPosition.distanceTo(signalMap->getPosition(DiscretePoint(x, y))).get<Distance::Unit::m>());
+				double power = sums[index] / counts[index] / averagedSteps;
+
+				signalMap->getElement(DiscretePoint(x, y)) = PowerCoefficient(power * 2 * wavelength() / distance);
+			}
+		}
+
+		return signalMap;
+	}
+};
\ No newline at end of file